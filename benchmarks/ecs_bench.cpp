@@ -0,0 +1,203 @@
+// ===== kawa::ecs benchmarks =====
+// usage: kawa_ecs_bench [max_entity_count] [max_worker_count]
+// results are printed to stdout as a json array, one object per measurement
+
+#include "../kawa/core/ecs.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace kawa;
+
+struct position { float x, y, z; };
+struct velocity { float x, y, z; };
+struct health { int hp; };
+
+using bench_clock = std::chrono::steady_clock;
+
+static volatile u64 bench_sink = 0;
+static bool first_result = true;
+
+static void report(const char* name, usize entities, usize workers, usize reps, u64 best_ns)
+{
+	std::printf("%s\n  { \"name\": \"%s\", \"entities\": %zu, \"workers\": %zu, \"reps\": %zu, \"ns\": %llu, \"ns_per_entity\": %.3f }",
+		first_result ? "" : ",",
+		name,
+		entities,
+		workers,
+		reps,
+		(unsigned long long)best_ns,
+		entities ? (double)best_ns / (double)entities : 0.0
+	);
+
+	first_result = false;
+}
+
+// runs setup untimed and body timed, keeps the fastest repetition
+template<typename Setup, typename Body>
+static u64 measure(usize reps, Setup&& setup, Body&& body)
+{
+	u64 best = ~u64(0);
+
+	for (usize r = 0; r < reps; r++)
+	{
+		setup();
+
+		auto begin = bench_clock::now();
+		body();
+		auto end = bench_clock::now();
+
+		u64 ns = (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+		best = ns < best ? ns : best;
+	}
+
+	return best;
+}
+
+static void populate(registry& reg, usize count)
+{
+	for (usize i = 0; i < count; i++)
+	{
+		entity_id e = reg.entity(position{ (float)i, 0.0f, 0.0f });
+
+		if (i % 2 == 0)
+		{
+			reg.emplace<velocity>(e, 1.0f, 1.0f, 1.0f);
+		}
+	}
+}
+
+static void bench_size(usize count, usize max_workers)
+{
+	usize reps = count <= 1000 ? 50 : count <= 100000 ? 10 : 3;
+
+	registry::config cfg{ .name = "bench", .max_entity_count = count };
+
+	{
+		registry reg(cfg);
+
+		u64 ns = measure(reps,
+			[&]() {},
+			[&]()
+			{
+				for (usize i = 0; i < count; i++) reg.entity();
+				for (usize i = 0; i < count; i++) reg.destroy(i);
+			}
+		);
+
+		report("entity_churn", count, 1, reps, ns);
+	}
+
+	registry reg(cfg);
+	populate(reg, count);
+
+	{
+		u64 ns = measure(reps,
+			[&]() {},
+			[&]()
+			{
+				for (usize i = 0; i < count; i++) reg.emplace<health>(i, 100);
+				for (usize i = 0; i < count; i++) reg.erase<health>(i);
+			}
+		);
+
+		report("emplace_erase", count, 1, reps, ns);
+	}
+
+	{
+		u64 ns = measure(reps,
+			[&]() {},
+			[&]()
+			{
+				reg.query([](position& p) { p.x += 1.0f; });
+			}
+		);
+
+		report("query_single", count, 1, reps, ns);
+	}
+
+	{
+		u64 ns = measure(reps,
+			[&]() {},
+			[&]()
+			{
+				reg.query([](position& p, const velocity& v) { p.x += v.x; p.y += v.y; p.z += v.z; });
+			}
+		);
+
+		report("query_multi", count, 1, reps, ns);
+	}
+
+	for (usize workers = 1; workers <= max_workers; workers *= 2)
+	{
+		task_manager tm(workers);
+		dyn_array<task_handle> handles;
+
+		u64 ns = measure(reps,
+			[&]() { handles.clear(); },
+			[&]()
+			{
+				reg.query_par(tm, task_schedule_policy::wait_if_neccesary, workers, handles,
+					[](position& p, const velocity& v) { p.x += v.x; p.y += v.y; p.z += v.z; }
+				);
+				tm.wait(handles);
+			}
+		);
+
+		report("query_par", count, workers, reps, ns);
+	}
+
+	{
+		registry::defer_buffer defer = reg.defer(false);
+
+		u64 ns = measure(reps,
+			[&]()
+			{
+				for (usize i = 0; i < count; i++) defer.emplace<health>(i, 100);
+			},
+			[&]()
+			{
+				defer.flush();
+			}
+		);
+
+		reg.query([](health& h) { bench_sink = bench_sink + h.hp; });
+
+		report("defer_flush", count, 1, reps, ns);
+	}
+
+	{
+		u64 ns = measure(reps,
+			[&]() {},
+			[&]()
+			{
+				registry copy = reg;
+				bench_sink = bench_sink + copy.entity_count();
+			}
+		);
+
+		report("registry_copy", count, 1, reps, ns);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	usize max_entities = argc > 1 ? (usize)std::strtoull(argv[1], nullptr, 10) : 10000000;
+	usize max_workers = argc > 2 ? (usize)std::strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+
+	max_workers = max_workers ? max_workers : 1;
+
+	std::printf("[");
+
+	for (usize count : { 1000, 100000, 1000000, 10000000 })
+	{
+		if (count <= max_entities)
+		{
+			bench_size(count, max_workers);
+		}
+	}
+
+	std::printf("\n]\n");
+}
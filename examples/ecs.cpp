@@ -176,6 +176,15 @@ int main()
 
     tm.wait(query_handles);
 
+    float parallel_total_health = reg.query_par_reduce
+    (
+        tm,
+        0.0f,
+        [](const Health& h) { return h.hp; },
+        [](float acc, float hp) { return acc + hp; }
+    );
+    std::cout << "Total health (parallel): " << parallel_total_health << '\n';
+
     // === 3.11 Single-entity query ===
     reg.query_with
     (
@@ -0,0 +1,123 @@
+#ifndef KAWA_BYTE_STREAM
+#define KAWA_BYTE_STREAM
+
+#include <cstring>
+
+#include "core_types.h"
+
+namespace kawa
+{
+	struct byte_writer
+	{
+		byte_writer(dyn_array<u8>& out) noexcept
+			: _out(out)
+		{
+		}
+
+		template<typename T>
+		void write(const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "byte_writer can only write trivially copyable types");
+
+			write_bytes(&value, sizeof(T));
+		}
+
+		void write_bytes(const void* data, usize size)
+		{
+			auto bytes = reinterpret_cast<const u8*>(data);
+			_out.insert(_out.end(), bytes, bytes + size);
+		}
+
+		void write_varint(u64 value)
+		{
+			while (value >= 0x80)
+			{
+				_out.push_back(static_cast<u8>(value | 0x80));
+				value >>= 7;
+			}
+
+			_out.push_back(static_cast<u8>(value));
+		}
+
+		template<typename T>
+		usize reserve()
+		{
+			usize at = _out.size();
+			_out.resize(at + sizeof(T));
+			return at;
+		}
+
+		template<typename T>
+		void write_at(usize at, const T& value) noexcept
+		{
+			kw_assert(at + sizeof(T) <= _out.size());
+			memcpy(_out.data() + at, &value, sizeof(T));
+		}
+
+		usize size() const noexcept
+		{
+			return _out.size();
+		}
+
+		dyn_array<u8>& _out;
+	};
+
+	struct byte_reader
+	{
+		byte_reader(const u8* data, usize size) noexcept
+			: _data(data)
+			, _size(size)
+		{
+		}
+
+		byte_reader(const dyn_array<u8>& data) noexcept
+			: byte_reader(data.data(), data.size())
+		{
+		}
+
+		template<typename T>
+		T read() noexcept
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "byte_reader can only read trivially copyable types");
+
+			T value;
+			memcpy(&value, read_bytes(sizeof(T)), sizeof(T));
+			return value;
+		}
+
+		const u8* read_bytes(usize size) noexcept
+		{
+			kw_verify_msg(_offset + size <= _size, "byte_reader overflow, requested {} bytes at {} of {}", size, _offset, _size);
+
+			const u8* out = _data + _offset;
+			_offset += size;
+			return out;
+		}
+
+		u64 read_varint() noexcept
+		{
+			u64 value = 0;
+
+			for (u32 shift = 0; shift < 64; shift += 7)
+			{
+				u8 byte = read<u8>();
+				value |= static_cast<u64>(byte & 0x7f) << shift;
+
+				if (!(byte & 0x80)) break;
+			}
+
+			return value;
+		}
+
+		bool empty() const noexcept
+		{
+			return _offset >= _size;
+		}
+
+		const u8* _data = nullptr;
+		usize _size = 0;
+		usize _offset = 0;
+	};
+}
+
+#endif // !KAWA_BYTE_STREAM
@@ -11,10 +11,21 @@
 #include "any.h"
 #include "testing.h"
 #include "ring_buffer.h"
+#include "task_fn.h"
 #include "task_manager.h"
+#include "task_graph.h"
+#include "coroutine.h"
 #include "indirect_array.h"
 #include "fast_map.h"
 #include "stable_tuple.h"
+#include "mapped_file.h"
+#include "byte_stream.h"
+#include "huge_page_resource.h"
+#include "soa.h"
+#include "event_channel.h"
+#include "entity_id.h"
+#include "query_detail.h"
 #include "ecs.h"
+#include "static_registry.h"
 
 #endif // !KAWA_CORE
@@ -5,6 +5,7 @@
 #include <cstdint>
 #include <vector>
 #include <array>
+#include <span>
 #include <set>
 #include <unordered_set>
 #include <map>
@@ -14,6 +15,7 @@
 #include <thread>
 #include <string_view>
 #include <new>
+#include <memory_resource>
 #include <ranges>
 #include <type_traits>
 
@@ -73,14 +75,61 @@ namespace kawa
 	template<typename T, usize size>
 	using array = std::array<T, size>;
 
+	template<typename T>
+	using span = std::span<T>;
+
 	using thread = std::thread;
 
 	template<typename T>
 	using unique = std::unique_ptr<T>;
 
+	template<typename T>
+	using shared = std::shared_ptr<T>;
+
 	template<typename T>
 	using atomic = std::atomic<T>;
 
+	using memory_resource = std::pmr::memory_resource;
+
+	inline memory_resource* default_memory_resource() noexcept
+	{
+		return std::pmr::get_default_resource();
+	}
+
+	// like std::pmr::polymorphic_allocator but it follows the source container on copy, move and swap,
+	// the same way the kawa containers that take a memory_resource do
+	template<typename T>
+	struct resource_allocator
+	{
+		using value_type = T;
+		using propagate_on_container_copy_assignment = std::true_type;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+
+		resource_allocator(memory_resource* r = default_memory_resource()) noexcept : resource(r) {}
+
+		template<typename U>
+		resource_allocator(const resource_allocator<U>& other) noexcept : resource(other.resource) {}
+
+		T* allocate(usize n)
+		{
+			return static_cast<T*>(resource->allocate(n * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* ptr, usize n) noexcept
+		{
+			resource->deallocate(ptr, n * sizeof(T), alignof(T));
+		}
+
+		template<typename U>
+		bool operator==(const resource_allocator<U>& other) const noexcept
+		{
+			return resource == other.resource;
+		}
+
+		memory_resource* resource;
+	};
+
 }
 
 #endif // !KAWA_TYPES
@@ -0,0 +1,342 @@
+#ifndef KAWA_COROUTINE
+#define KAWA_COROUTINE
+
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <optional>
+
+#include "core_types.h"
+#include "task_manager.h"
+
+namespace kawa
+{
+	template<typename T>
+	struct task;
+
+	template<typename T>
+	struct _task_promise_base
+	{
+		struct final_awaiter
+		{
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+
+			template<typename promise_t>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_t> h) noexcept
+			{
+				std::coroutine_handle<> continuation = h.promise()._continuation;
+				return continuation ? continuation : std::noop_coroutine();
+			}
+
+			void await_resume() const noexcept {}
+		};
+
+		std::suspend_always initial_suspend() const noexcept
+		{
+			return {};
+		}
+
+		final_awaiter final_suspend() const noexcept
+		{
+			return {};
+		}
+
+		void unhandled_exception() noexcept
+		{
+			_exception = std::current_exception();
+		}
+
+		void _rethrow() const
+		{
+			if (_exception)
+			{
+				std::rethrow_exception(_exception);
+			}
+		}
+
+		std::coroutine_handle<> _continuation;
+		std::exception_ptr _exception;
+	};
+
+	template<typename T>
+	struct _task_promise : _task_promise_base<T>
+	{
+		task<T> get_return_object() noexcept;
+
+		template<typename U>
+		void return_value(U&& v)
+		{
+			_value.emplace(std::forward<U>(v));
+		}
+
+		T _take()
+		{
+			this->_rethrow();
+			return std::move(*_value);
+		}
+
+		std::optional<T> _value;
+	};
+
+	template<>
+	struct _task_promise<void> : _task_promise_base<void>
+	{
+		task<void> get_return_object() noexcept;
+
+		void return_void() noexcept {}
+
+		void _take()
+		{
+			_rethrow();
+		}
+	};
+
+	// lazily started coroutine, runs when awaited and hands control back to its awaiter when it
+	// finishes, awaiting task handles or resume_on(tm) moves the rest of it onto a worker
+	template<typename T = void>
+	struct task
+	{
+		using promise_type = _task_promise<T>;
+
+		task() noexcept = default;
+
+		explicit task(std::coroutine_handle<promise_type> h) noexcept
+			: _handle(h)
+		{
+		}
+
+		task(const task&) = delete;
+		task& operator=(const task&) = delete;
+
+		task(task&& other) noexcept
+			: _handle(std::exchange(other._handle, nullptr))
+		{
+		}
+
+		task& operator=(task&& other) noexcept
+		{
+			if (this != &other)
+			{
+				release();
+				_handle = std::exchange(other._handle, nullptr);
+			}
+
+			return *this;
+		}
+
+		~task() noexcept
+		{
+			release();
+		}
+
+		void release() noexcept
+		{
+			if (_handle)
+			{
+				_handle.destroy();
+				_handle = nullptr;
+			}
+		}
+
+		bool done() const noexcept
+		{
+			return !_handle || _handle.done();
+		}
+
+		bool await_ready() const noexcept
+		{
+			return !_handle || _handle.done();
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+		{
+			_handle.promise()._continuation = awaiter;
+			return _handle;
+		}
+
+		T await_resume()
+		{
+			kw_assert(_handle);
+			return _handle.promise()._take();
+		}
+
+		std::coroutine_handle<promise_type> _handle;
+	};
+
+	template<typename T>
+	inline task<T> _task_promise<T>::get_return_object() noexcept
+	{
+		return task<T>{ std::coroutine_handle<_task_promise<T>>::from_promise(*this) };
+	}
+
+	inline task<void> _task_promise<void>::get_return_object() noexcept
+	{
+		return task<void>{ std::coroutine_handle<_task_promise<void>>::from_promise(*this) };
+	}
+
+	// suspends until the task behind the handle is finished, the coroutine is resumed on the thread that ran it
+	struct task_handle_awaiter
+	{
+		bool await_ready() const noexcept
+		{
+			return th.done();
+		}
+
+		void await_suspend(std::coroutine_handle<> h) noexcept
+		{
+			_waiter.handle = h;
+			_waiter.generation = th.generation;
+
+			// may resume h before returning, nothing may be touched after this
+			task_manager::_push_waiter(*th.node, &_waiter);
+		}
+
+		void await_resume() const noexcept {}
+
+		task_handle th;
+		task_waiter _waiter{};
+	};
+
+	inline task_handle_awaiter when_done(task_handle th) noexcept
+	{
+		return { th };
+	}
+
+	// handles of a query_par can be awaited as a whole, the coroutine continues on whichever worker finishes last
+	inline task<void> when_all(dyn_array<task_handle> handles)
+	{
+		for (const task_handle& th : handles)
+		{
+			co_await when_done(th);
+		}
+	}
+
+	struct resume_on_awaiter
+	{
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> h)
+		{
+			tm.schedule([h]() { h.resume(); }, task_schedule_policy::wait_if_neccesary);
+		}
+
+		void await_resume() const noexcept {}
+
+		task_manager& tm;
+	};
+
+	// continues the coroutine on a worker of tm, it keeps that worker busy until it suspends again
+	inline resume_on_awaiter resume_on(task_manager& tm) noexcept
+	{
+		return { tm };
+	}
+
+	struct _detached_task
+	{
+		struct promise_type
+		{
+			_detached_task get_return_object() const noexcept
+			{
+				return {};
+			}
+
+			std::suspend_never initial_suspend() const noexcept
+			{
+				return {};
+			}
+
+			std::suspend_never final_suspend() const noexcept
+			{
+				return {};
+			}
+
+			void return_void() const noexcept {}
+
+			void unhandled_exception() const noexcept
+			{
+				std::terminate();
+			}
+		};
+	};
+
+	inline _detached_task _spawn_impl(task_manager& tm, task<void> t)
+	{
+		co_await resume_on(tm);
+		co_await t;
+	}
+
+	// starts the task on a worker and lets it clean up after itself, exceptions escaping it terminate
+	inline void spawn(task_manager& tm, task<void>&& t)
+	{
+		_spawn_impl(tm, std::move(t));
+	}
+
+	// the promise lives in the coroutine frame so signalling it can't race with sync_wait returning
+	template<typename T>
+	inline _detached_task _sync_wait_impl(task<T>& t, std::promise<void> done, std::optional<T>& out, std::exception_ptr& ex)
+	{
+		try
+		{
+			out.emplace(co_await t);
+		}
+		catch (...)
+		{
+			ex = std::current_exception();
+		}
+
+		done.set_value();
+	}
+
+	inline _detached_task _sync_wait_impl(task<void>& t, std::promise<void> done, std::exception_ptr& ex)
+	{
+		try
+		{
+			co_await t;
+		}
+		catch (...)
+		{
+			ex = std::current_exception();
+		}
+
+		done.set_value();
+	}
+
+	// runs the task on the calling thread until it first suspends, then blocks until it is finished,
+	// meant for the outermost caller, never from inside a coroutine or a worker
+	template<typename T>
+	T sync_wait(task<T> t)
+	{
+		std::promise<void> done;
+		std::future<void> finished = done.get_future();
+		std::exception_ptr ex;
+
+		if constexpr (std::is_void_v<T>)
+		{
+			_sync_wait_impl(t, std::move(done), ex);
+
+			finished.wait();
+
+			if (ex) std::rethrow_exception(ex);
+		}
+		else
+		{
+			std::optional<T> out;
+
+			_sync_wait_impl(t, std::move(done), out, ex);
+
+			finished.wait();
+
+			if (ex) std::rethrow_exception(ex);
+
+			return std::move(*out);
+		}
+	}
+}
+
+#endif // !KAWA_COROUTINE
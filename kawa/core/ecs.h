@@ -3,100 +3,507 @@
 
 #include "core_types.h"
 #include "macros.h"
+#include "indirect_array.h"
 #include "fast_map.h"
 #include "task_manager.h"
+#include "mapped_file.h"
+#include "byte_stream.h"
+#include "soa.h"
+#include "event_channel.h"
+#include "entity_id.h"
+#include "query_detail.h"
+
+#include <fstream>
 
 namespace kawa
 {
-	struct entity_id
+	inline atomic<usize> _component_type_id_counter{ 0 };
+
+	template<typename T>
+	inline usize component_type_id() noexcept
+	{
+		static const usize id = _component_type_id_counter.fetch_add(1, std::memory_order_relaxed);
+		return id;
+	}
+
+	inline atomic<usize> _event_type_id_counter{ 0 };
+
+	template<typename T>
+	inline usize event_type_id() noexcept
+	{
+		static const usize id = _event_type_id_counter.fetch_add(1, std::memory_order_relaxed);
+		return id;
+	}
+
+	struct component_info
+	{
+		meta::type_info type_info;
+		void* value_ptr;
+	};
+
+	struct storage_memory_info
+	{
+		string_view type_name;
+		usize occupied = 0;
+		usize capacity = 0;
+		usize data_bytes = 0;
+		usize metadata_bytes = 0;
+		f32 fill_ratio = 0.0f;
+		bool mapped = false;
+	};
+
+	struct memory_report_info
 	{
-		constexpr static u64 invalid = std::numeric_limits<u64>::max();
+		dyn_array<storage_memory_info> storages;
+
+		usize entity_bytes = 0;
+		usize directory_bytes = 0;
+		usize data_bytes = 0;
+		usize metadata_bytes = 0;
+		usize total_bytes = 0;
+	};
+
+	template<typename T>
+	struct _component_invoker
+	{
+		template<typename F>
+		static inline void call(F& fn, usize index, void* comp)
+		{
+			fn(entity_id(index), *reinterpret_cast<T*>(comp));
+		}
+	};
+
+	struct _batch_invoker
+	{
+		template<typename F>
+		static inline void call(F& fn, usize count, void* ids)
+		{
+			fn(span<const entity_id>(reinterpret_cast<const entity_id*>(ids), count));
+		}
+	};
+
+	// type erased lifetime hook, captures that fit inline_capacity live in place,
+	// bigger (or throwing on move) ones are kept on the heap
+	struct _lifetime_listener
+	{
+		constexpr static usize inline_capacity = 40;
+
+		struct vtable
+		{
+			void(*invoke)(void*, usize, void*);
+			void(*copy)(const void*, void*);
+			void(*move)(void*, void*);
+			void(*dtor)(void*);
+			usize size;
+			usize alignment;
+		};
+
+		template<typename F>
+		constexpr static bool _fits_inline = sizeof(F) <= inline_capacity && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<F>;
+
+		template<typename F, typename invoker_t>
+		inline static const vtable _vtable_for =
+		{
+			+[](void* fn, usize e, void* comp)
+			{
+				invoker_t::template call<F>(*reinterpret_cast<F*>(fn), e, comp);
+			},
+			+[](const void* from, void* to)
+			{
+				new (to) F(*reinterpret_cast<const F*>(from));
+			},
+			+[](void* from, void* to)
+			{
+				new (to) F(std::move(*reinterpret_cast<F*>(from)));
+				reinterpret_cast<F*>(from)->~F();
+			},
+			+[](void* fn)
+			{
+				reinterpret_cast<F*>(fn)->~F();
+			},
+			sizeof(F),
+			alignof(F)
+		};
 
-		entity_id() noexcept : val(invalid) {}
-		entity_id(u64 id) noexcept : val(id) {}
+		_lifetime_listener() noexcept = default;
 
-		bool is_valid() const noexcept
+		template<typename invoker_t, typename Fn>
+		_lifetime_listener(meta::construct_tag<invoker_t>, usize listener_id, Fn&& fn)
+			: id(listener_id)
 		{
-			return val != invalid;
+			using F = std::remove_cvref_t<Fn>;
+
+			static_assert(std::is_copy_constructible_v<F>, "lifetime listeners must be copyable, copying a registry copies them along with the storages");
+
+			_vt = &_vtable_for<F, invoker_t>;
+
+			if constexpr (_fits_inline<F>)
+			{
+				new (_buffer) F(std::forward<Fn>(fn));
+			}
+			else
+			{
+				_heap = new (::operator new(sizeof(F), std::align_val_t{ alignof(F) })) F(std::forward<Fn>(fn));
+			}
 		}
 
-		operator u64& () noexcept
+		_lifetime_listener(const _lifetime_listener& other)
 		{
-			return val;
+			_copy_from(other);
 		}
 
-		operator const u64& () const noexcept
+		_lifetime_listener(_lifetime_listener&& other) noexcept
 		{
-			return val;
+			_move_from(other);
 		}
 
-		u64 val;
-	};
+		_lifetime_listener& operator=(const _lifetime_listener& other)
+		{
+			if (this != &other)
+			{
+				release();
+				_copy_from(other);
+			}
 
-	struct component_info
-	{
-		meta::type_info type_info;
-		void* value_ptr;
-	};
+			return *this;
+		}
 
-	struct _opaque_callback_wrap
-	{
-		using invoker_fn_t = void(unsized_any&, usize, void*);
+		_lifetime_listener& operator=(_lifetime_listener&& other) noexcept
+		{
+			if (this != &other)
+			{
+				release();
+				_move_from(other);
+			}
+
+			return *this;
+		}
+
+		~_lifetime_listener() noexcept
+		{
+			release();
+		}
+
+		void _copy_from(const _lifetime_listener& other)
+		{
+			id = other.id;
+			_vt = other._vt;
+
+			if (!_vt) return;
+
+			if (other._heap)
+			{
+				_heap = ::operator new(_vt->size, std::align_val_t{ _vt->alignment });
+				_vt->copy(other._heap, _heap);
+			}
+			else
+			{
+				_vt->copy(other._buffer, _buffer);
+			}
+		}
+
+		void _move_from(_lifetime_listener& other) noexcept
+		{
+			id = other.id;
+			_vt = other._vt;
+			_heap = other._heap;
+
+			if (_vt && !_heap)
+			{
+				_vt->move(other._buffer, _buffer);
+			}
+
+			other._vt = nullptr;
+			other._heap = nullptr;
+		}
 
-		unsized_any _storage;
-		invoker_fn_t* invoker = nullptr;
+		void release() noexcept
+		{
+			if (!_vt) return;
 
+			if (_heap)
+			{
+				_vt->dtor(_heap);
+				::operator delete(_heap, _vt->size, std::align_val_t{ _vt->alignment });
+				_heap = nullptr;
+			}
+			else
+			{
+				_vt->dtor(_buffer);
+			}
 
-		_opaque_callback_wrap() noexcept = default;
-		_opaque_callback_wrap(const _opaque_callback_wrap& other) noexcept = default;
-		_opaque_callback_wrap(_opaque_callback_wrap& other) noexcept = default;
+			_vt = nullptr;
+		}
 
-		_opaque_callback_wrap& operator=(const _opaque_callback_wrap& other) noexcept = default;
-		_opaque_callback_wrap& operator=(_opaque_callback_wrap& other) noexcept = default;
+		inline void operator()(usize index, void* comp)
+		{
+			_vt->invoke(_heap ? _heap : _buffer, index, comp);
+		}
 
+		alignas(std::max_align_t) u8 _buffer[inline_capacity];
+		void* _heap = nullptr;
+		const vtable* _vt = nullptr;
+		usize id = 0;
+	};
 
-		template<typename Fn, typename...Args>
-		void refresh(Args&&...args)
+	// immediate listeners run inside the emplace / erase that raised the event, batch listeners
+	// only get the entity ids queued since the last flush, delivered at once by flush(), listeners
+	// may connect and disconnect listeners (themselves included) while being dispatched, those
+	// changes are held back until the outermost dispatch returns so the lists never move under it
+	struct lifetime_signal
+	{
+		template<typename Fn>
+		usize connect(Fn&& fn)
 		{
 			static_assert(std::is_same_v<typename meta::function_traits<Fn>::template arg_at<0>, entity_id>, "lifetime hook callbacks require first parameter to be entity id");
 
 			using T = std::remove_cvref_t<typename meta::function_traits<Fn>::template arg_at<1>>;
 
-			_storage.refresh<Fn>(std::forward<Args>(args)...);
-			invoker = +[](unsized_any& fn, usize e, void* comp)
+			usize id = _next_id++;
+			(_dispatching ? _added_listeners : _listeners).emplace_back(meta::construct_tag<_component_invoker<T>>{}, id, std::forward<Fn>(fn));
+			_listener_count++;
+			return id;
+		}
+
+		template<typename Fn>
+		usize connect_batch(Fn&& fn)
+		{
+			static_assert(std::is_invocable_v<Fn&, span<const entity_id>>, "batch lifetime hook callbacks require a single span<const entity_id> parameter");
+
+			usize id = _next_id++;
+			(_dispatching ? _added_batch_listeners : _batch_listeners).emplace_back(meta::construct_tag<_batch_invoker>{}, id, std::forward<Fn>(fn));
+			_batch_listener_count++;
+			return id;
+		}
+
+		bool disconnect(usize id) noexcept
+		{
+			if (!id) return false;
+
+			for (auto* list : { &_listeners, &_batch_listeners, &_added_listeners, &_added_batch_listeners })
+			{
+				for (usize i = 0; i < list->size(); i++)
 				{
-					fn.unwrap<Fn>()(e, *reinterpret_cast<T*>(comp));
-				};
+					if ((*list)[i].id != id) continue;
+
+					bool batch = list == &_batch_listeners || list == &_added_batch_listeners;
+
+					// the listener may be the one running right now, it is only released after the dispatch
+					if (_dispatching && (list == &_listeners || list == &_batch_listeners))
+					{
+						(*list)[i].id = 0;
+						_tombstones++;
+					}
+					else
+					{
+						list->erase(list->begin() + i);
+					}
+
+					(batch ? _batch_listener_count : _listener_count)--;
+
+					if (!_batch_listener_count)
+					{
+						_queue.clear();
+					}
+
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void clear() noexcept
+		{
+			if (_dispatching)
+			{
+				for (auto* list : { &_listeners, &_batch_listeners })
+				{
+					for (auto& l : *list)
+					{
+						_tombstones += l.id != 0;
+						l.id = 0;
+					}
+				}
+			}
+			else
+			{
+				_listeners.clear();
+				_batch_listeners.clear();
+			}
+
+			_added_listeners.clear();
+			_added_batch_listeners.clear();
+			_listener_count = 0;
+			_batch_listener_count = 0;
+			_queue.clear();
+		}
+
+		bool empty() const noexcept
+		{
+			return !_listener_count && !_batch_listener_count;
+		}
+
+		bool has_batch_listeners() const noexcept
+		{
+			return _batch_listener_count;
+		}
+
+		usize size() const noexcept
+		{
+			return _listener_count + _batch_listener_count;
+		}
+
+		inline void invoke(usize index, void* comp)
+		{
+			if (empty()) [[likely]]
+			{
+				return;
+			}
+
+			_dispatch_scope scope(*this);
+
+			// listeners connected from inside a listener only see the next event
+			for (usize i = 0, count = _listeners.size(); i < count; i++)
+			{
+				if (_listeners[i].id)
+				{
+					_listeners[i](index, comp);
+				}
+			}
+
+			if (_batch_listener_count)
+			{
+				_queue.emplace_back(index);
+			}
 		}
 
-		void release()
+		// events raised by batch listeners themselves are kept for the next flush
+		void flush()
 		{
-			_storage.release();
-			invoker = nullptr;
+			if (_queue.empty()) return;
+
+			dyn_array<entity_id> batch;
+			batch.swap(_queue);
+
+			{
+				_dispatch_scope scope(*this);
+
+				for (usize i = 0, count = _batch_listeners.size(); i < count; i++)
+				{
+					if (_batch_listeners[i].id)
+					{
+						_batch_listeners[i](batch.size(), batch.data());
+					}
+				}
+			}
+
+			if (_queue.empty())
+			{
+				batch.clear();
+				batch.swap(_queue);
+			}
 		}
 
-		void try_invoke(usize index, void* comp) noexcept
+		struct _dispatch_scope
+		{
+			_dispatch_scope(lifetime_signal& s) noexcept : signal(s)
+			{
+				signal._dispatching++;
+			}
+
+			~_dispatch_scope()
+			{
+				if (!--signal._dispatching)
+				{
+					signal._apply_pending();
+				}
+			}
+
+			lifetime_signal& signal;
+		};
+
+		void _apply_pending()
 		{
-			if (invoker)
+			if (_tombstones)
+			{
+				std::erase_if(_listeners, [](const _lifetime_listener& l) { return !l.id; });
+				std::erase_if(_batch_listeners, [](const _lifetime_listener& l) { return !l.id; });
+				_tombstones = 0;
+			}
+
+			for (auto& l : _added_listeners)
+			{
+				_listeners.emplace_back(std::move(l));
+			}
+
+			for (auto& l : _added_batch_listeners)
 			{
-				invoker(_storage, index, comp);
+				_batch_listeners.emplace_back(std::move(l));
 			}
+
+			_added_listeners.clear();
+			_added_batch_listeners.clear();
 		}
+
+		dyn_array<_lifetime_listener> _listeners;
+		dyn_array<_lifetime_listener> _batch_listeners;
+		dyn_array<_lifetime_listener> _added_listeners;
+		dyn_array<_lifetime_listener> _added_batch_listeners;
+		dyn_array<entity_id> _queue;
+		usize _listener_count = 0;
+		usize _batch_listener_count = 0;
+		usize _tombstones = 0;
+		u32 _dispatching = 0;
+		usize _next_id = 1;
 	};
 	
 	struct component_storage : indirect_array_base
 	{
 		lifetime_vtable _vtable;
 
-		_opaque_callback_wrap on_construct_callback;
-		_opaque_callback_wrap on_destruct_callback;
+		lifetime_signal on_construct_signal;
+		lifetime_signal on_destruct_signal;
+
+		bool _mapped = false;
+
+		const soa_layout_info* _soa = nullptr;
+		dyn_array<u8> _soa_scratch;
+
+		struct mapped_arrays
+		{
+			u8* storage = nullptr;
+			bool* mask = nullptr;
+			usize* indirect_map = nullptr;
+			usize* reverse_indirect_map = nullptr;
+			usize capacity = 0;
+			usize occupied = 0;
+		};
 
 		template<typename T>
-		component_storage(meta::construct_tag<T>, usize capacity)
+		component_storage(meta::construct_tag<T>, usize capacity, memory_resource* resource = default_memory_resource())
 		{
+			_resource = resource;
 			refresh<T>(capacity);
 		}
 
+		template<typename T>
+		component_storage(meta::construct_tag<T>, const mapped_arrays& arrays)
+		{
+			adopt<T>(arrays);
+		}
+
+		component_storage(const lifetime_vtable& vtable, const soa_layout_info* soa, usize capacity, memory_resource* resource = default_memory_resource())
+		{
+			_resource = resource;
+			_vtable = vtable;
+			_capacity = capacity;
+
+			_set_soa(soa);
+
+			_allocate();
+		}
+
 		component_storage& operator=(const component_storage& other)
 		{
 			if (this != &other)
@@ -106,19 +513,28 @@ namespace kawa
 				_vtable = other._vtable;
 				_capacity = other._capacity;
 				_occupied = other._occupied;
+				_resource = other._resource;
 
+				_set_soa(other._soa);
 				_allocate();
 
 				memcpy(_mask, other._mask, _capacity * sizeof(_mask[0]));
 				memcpy(_indirect_map, other._indirect_map, _capacity * sizeof(_indirect_map[0]));
 				memcpy(_reverse_indirect_map, other._reverse_indirect_map, _capacity * sizeof(_reverse_indirect_map[0]));
 				
-				on_destruct_callback = other.on_construct_callback;
-				on_construct_callback = other.on_construct_callback;
+				on_construct_signal = other.on_construct_signal;
+				on_destruct_signal = other.on_destruct_signal;
 
-				for (auto e : other)
+				if (_soa)
+				{
+					memcpy(_storage, other._storage, _capacity * _vtable.type_info.size);
+				}
+				else
 				{
-					_vtable.copy_ctor_offset(other._storage, e, _storage, e);
+					for (auto e : other)
+					{
+						_vtable.copy_ctor_offset(other._storage, e, _storage, e);
+					}
 				}
 			}
 
@@ -143,6 +559,12 @@ namespace kawa
 				_mask = other._mask;
 				_indirect_map = other._indirect_map;
 				_reverse_indirect_map = other._reverse_indirect_map;
+				_mapped = other._mapped;
+				_resource = other._resource;
+				_soa = other._soa;
+				_soa_scratch = std::move(other._soa_scratch);
+				on_construct_signal = std::move(other.on_construct_signal);
+				on_destruct_signal = std::move(other.on_destruct_signal);
 				
 				other._vtable.release();
 				other.release();
@@ -169,87 +591,290 @@ namespace kawa
 			_vtable.refresh<T>();
 			_capacity = capacity;
 
+			_set_soa<T>();
 			_allocate();
 		}
 
-		void _allocate()
+		template<typename T>
+		void adopt(const mapped_arrays& arrays)
 		{
-			_storage = (u8*)::operator new(_capacity * _vtable.type_info.size, std::align_val_t{ _vtable.type_info.alignment });
-			_mask = new bool[_capacity] {};
-			_indirect_map = new usize[_capacity]{};
-			_reverse_indirect_map = new usize[_capacity]{};
-		}
+			static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable components can be adopted from mapped memory");
 
-		void release() noexcept
-		{
-			if (_vtable.type_info)
-			{
-				for (auto i : *(indirect_array_base*)this)
-				{
-					_destruct_try_callback(i);
-				}
+			release();
 
-				::operator delete(_storage, _vtable.type_info.size * _capacity, std::align_val_t{ _vtable.type_info.alignment });
+			_vtable.refresh<T>();
+			_capacity = arrays.capacity;
+			_occupied = arrays.occupied;
 
-				_storage = nullptr;
+			_set_soa<T>();
 
-				delete[] _mask;
-				delete[] _indirect_map;
-				delete[] _reverse_indirect_map;
-				_occupied = 0;
+			_storage = arrays.storage;
+			_mask = arrays.mask;
+			_indirect_map = arrays.indirect_map;
+			_reverse_indirect_map = arrays.reverse_indirect_map;
 
-				_vtable.release();
+			_mapped = true;
+		}
 
-				on_construct_callback.release();
-				on_destruct_callback.release();
+		template<typename T>
+		void _set_soa() noexcept
+		{
+			if constexpr (is_soa_v<T>)
+			{
+				_set_soa(&_soa_traits<T>::info());
+			}
+			else
+			{
+				_set_soa(nullptr);
 			}
 		}
 
-		template<typename T, typename...Args>
-		T& _construct_try_callback(usize index, Args&&...args)
+		void _set_soa(const soa_layout_info* soa)
 		{
-			auto out = new (reinterpret_cast<T*>(_storage) + index) T(std::forward<Args>(args)...);
-
-			on_construct_callback.try_invoke(index, (void*)((u8*)_storage + index * _vtable.type_info.size));
-
-			return *out;
+			_soa = soa;
+			_soa_scratch.assign(soa ? _vtable.type_info.size : 0, 0);
 		}
 
-		void _copy_try_callback(usize from, usize to)
+		u8* _soa_field(usize field, usize index) const noexcept
 		{
-			_vtable.copy_ctor_offset(_storage, from, _storage, to);
-
-			on_construct_callback.try_invoke(to, (void*)((u8*)_storage + to * _vtable.type_info.size));
+			return _storage + _capacity * _soa->array_offsets[field] + index * _soa->sizes[field];
 		}
 
-		void _move_try_callback(usize from, usize to)
+		// soa elements are gathered into scratch, packed ones are returned in place
+		const u8* _element_bytes(usize index, u8* scratch) const noexcept
 		{
-			_vtable.move_ctor_offset(_storage, from, _storage, to);
+			if (!_soa) [[likely]]
+			{
+				return _storage + index * _vtable.type_info.size;
+			}
+
+			for (usize k = 0; k < _soa->field_count; k++)
+			{
+				memcpy(scratch + _soa->member_offsets[k], _soa_field(k, index), _soa->sizes[k]);
+			}
 
-			on_construct_callback.try_invoke(to, (void*)((u8*)_storage + to * _vtable.type_info.size));
+			return scratch;
 		}
 
-		void _destruct_try_callback(usize index)
+		void _store_bytes(usize index, const void* bytes) noexcept
 		{
-			on_destruct_callback.try_invoke(index, (void*)((u8*)_storage + index * _vtable.type_info.size));
-
-			_vtable.dtor_offset(_storage, index);
+			if (!_soa) [[likely]]
+			{
+				memcpy(_storage + index * _vtable.type_info.size, bytes, _vtable.type_info.size);
+				return;
+			}
+
+			for (usize k = 0; k < _soa->field_count; k++)
+			{
+				memcpy(_soa_field(k, index), (const u8*)bytes + _soa->member_offsets[k], _soa->sizes[k]);
+			}
+		}
+
+		// listeners of soa components get a gathered copy, writes to it are not stored back
+		void _notify(lifetime_signal& signal, usize index)
+		{
+			if (signal.empty()) [[likely]]
+			{
+				return;
+			}
+
+			signal.invoke(index, (void*)_element_bytes(index, _soa_scratch.data()));
+		}
+
+		void _allocate()
+		{
+			_allocate_arrays(_capacity, _vtable.type_info.size, _vtable.type_info.alignment);
+		}
+
+		void release() noexcept
+		{
+			if (_vtable.type_info)
+			{
+				for (auto i : *(indirect_array_base*)this)
+				{
+					_destruct_try_callback(i);
+				}
+
+				if (!_mapped)
+				{
+					_release_arrays(_vtable.type_info.size, _vtable.type_info.alignment);
+				}
+
+				_storage = nullptr;
+				_mask = nullptr;
+				_indirect_map = nullptr;
+				_reverse_indirect_map = nullptr;
+				_occupied = 0;
+				_mapped = false;
+				_soa = nullptr;
+
+				_vtable.release();
+
+				on_construct_signal.clear();
+				on_destruct_signal.clear();
+			}
+		}
+
+		template<typename T, typename...Args>
+		component_ref<T> _construct_try_callback(usize index, Args&&...args)
+		{
+			if constexpr (is_soa_v<T>)
+			{
+				T value(std::forward<Args>(args)...);
+				_store_bytes(index, &value);
+
+				_notify(on_construct_signal, index);
+
+				return _soa_traits<T>::make_ref(_soa_traits<T>::bases(_storage, _capacity), index);
+			}
+			else
+			{
+				auto out = new (reinterpret_cast<T*>(_storage) + index) T(std::forward<Args>(args)...);
+
+				_notify(on_construct_signal, index);
+
+				return *out;
+			}
+		}
+
+		void _emplace_bytes(usize index, const void* bytes) noexcept
+		{
+			kw_assert(_vtable.type_info.trivially_copyable);
+			kw_assert(index < _capacity);
+
+			_refresh_init(index);
+
+			_store_bytes(index, bytes);
+
+			_notify(on_construct_signal, index);
+		}
+
+		void _relocate_to(component_storage& dst, usize from, usize to)
+		{
+			kw_assert(contains(from));
+			kw_assert(dst._vtable.type_info == _vtable.type_info);
+
+			dst._refresh_init(to);
+
+			if (_vtable.type_info.trivially_copyable)
+			{
+				dst._store_bytes(to, _element_bytes(from, _soa_scratch.data()));
+			}
+			else
+			{
+				usize size = _vtable.type_info.size;
+				_vtable.move_ctor(_storage + from * size, dst._storage + to * size);
+			}
+
+			dst._notify(dst.on_construct_signal, to);
+
+			erase(from);
+		}
+
+		// moves every element at index i below end to remap[i] without raising lifetime events and
+		// rebuilds the indirect map in ascending index order, remap has to keep the order of the indices
+		// (remap[i] <= i) so every target is vacated before anything is moved into it
+		void _compact(const entity_id* remap, usize end) noexcept
+		{
+			usize size = _vtable.type_info.size;
+			usize occupied = 0;
+
+			for (usize from = 0; from < end; from++)
+			{
+				if (!_mask[from]) continue;
+
+				usize to = remap[from];
+
+				kw_assert(to <= from);
+
+				if (to != from)
+				{
+					if (_soa)
+					{
+						_soa_copy(from, to);
+					}
+					else if (_vtable.type_info.trivially_copyable)
+					{
+						memcpy(_storage + to * size, _storage + from * size, size);
+					}
+					else
+					{
+						_vtable.move_ctor_offset(_storage, from, _storage, to);
+						_vtable.dtor_offset(_storage, from);
+					}
+
+					_mask[from] = false;
+					_mask[to] = true;
+				}
+
+				_indirect_map[occupied] = to;
+				_reverse_indirect_map[to] = occupied;
+				occupied++;
+			}
+
+			kw_assert(occupied == _occupied);
+		}
+
+		void _copy_try_callback(usize from, usize to)
+		{
+			if (_soa)
+			{
+				_soa_copy(from, to);
+			}
+			else
+			{
+				_vtable.copy_ctor_offset(_storage, from, _storage, to);
+			}
+
+			_notify(on_construct_signal, to);
+		}
+
+		void _move_try_callback(usize from, usize to)
+		{
+			if (_soa)
+			{
+				_soa_copy(from, to);
+			}
+			else
+			{
+				_vtable.move_ctor_offset(_storage, from, _storage, to);
+			}
+
+			_notify(on_construct_signal, to);
+		}
+
+		void _soa_copy(usize from, usize to) noexcept
+		{
+			for (usize k = 0; k < _soa->field_count; k++)
+			{
+				memcpy(_soa_field(k, to), _soa_field(k, from), _soa->sizes[k]);
+			}
+		}
+
+		void _destruct_try_callback(usize index)
+		{
+			_notify(on_destruct_signal, index);
+
+			if (!_soa)
+			{
+				_vtable.dtor_offset(_storage, index);
+			}
 		}
 
 		template<typename Fn>
-		void set_on_construct(Fn&& func)
+		usize add_on_construct(Fn&& func)
 		{
-			on_construct_callback.refresh<Fn>(std::forward<Fn>(func));
+			return on_construct_signal.connect(std::forward<Fn>(func));
 		}
 
 		template<typename Fn>
-		void set_on_destruct(Fn&& func)
+		usize add_on_destruct(Fn&& func)
 		{
-			on_destruct_callback.refresh<Fn>(std::forward<Fn>(func));
+			return on_destruct_signal.connect(std::forward<Fn>(func));
 		}
 
 		template<typename T, typename...Args>
-		T& emplace(usize index, Args&&...args) noexcept
+		component_ref<T> emplace(usize index, Args&&...args) noexcept
 		{
 			kw_assert(_vtable.type_info.is<T>());
 			kw_assert(index < _capacity);
@@ -259,6 +884,23 @@ namespace kawa
 			return _construct_try_callback<T>(index, std::forward<Args>(args)...);
 		}
 
+		template<typename T, typename...Args>
+		component_ref<T> emplace_concurrent(usize index, Args&&...args) noexcept
+		{
+			kw_assert(_vtable.type_info.is<T>());
+			kw_assert(index < _capacity);
+
+			// batch listeners append to a shared queue, that would race between the creating threads
+			kw_verify_msg(!on_construct_signal.has_batch_listeners() && !on_destruct_signal.has_batch_listeners(), "batch listeners of {} can't be connected during concurrent creation", _vtable.type_info.name);
+
+			if (!_claim_concurrent(index))
+			{
+				_destruct_try_callback(index);
+			}
+
+			return _construct_try_callback<T>(index, std::forward<Args>(args)...);
+		}
+
 		void _refresh_init(usize index) noexcept
 		{
 			bool& cell = _mask[index];
@@ -299,18 +941,27 @@ namespace kawa
 		}
 
 		template<typename T>
-		T& get(usize index) noexcept
+		component_ref<T> get(usize index) noexcept
 		{
 			kw_assert_msg(_vtable.type_info.is<T>(), "got: {} expected: {}", meta::type_name<T>(), _vtable.type_info.name);
 			kw_assert(index < _capacity);
 			kw_assert(_mask[index]);
 
-			return reinterpret_cast<T*>(_storage)[index];
+			if constexpr (is_soa_v<T>)
+			{
+				return _soa_traits<T>::make_ref(_soa_traits<T>::bases(_storage, _capacity), index);
+			}
+			else
+			{
+				return reinterpret_cast<T*>(_storage)[index];
+			}
 		}
 
 		template<typename T>
 		const T& get(usize index) const noexcept
 		{
+			static_assert(!is_soa_v<T>, "soa components have no packed element to reference");
+
 			kw_assert(_vtable.type_info.is<T>());
 			kw_assert(index < _capacity);
 			kw_assert(_mask[index]);
@@ -321,6 +972,8 @@ namespace kawa
 		template<typename T>
 		T* try_get(usize index) noexcept
 		{
+			static_assert(!is_soa_v<T>, "soa components have no packed element to point to, check has<T>() and use get<T>()");
+
 			kw_assert(index < _capacity);
 			kw_assert(_vtable.type_info.is<T>());
 
@@ -335,6 +988,8 @@ namespace kawa
 		template<typename T>
 		const T* try_get(usize index) const noexcept
 		{
+			static_assert(!is_soa_v<T>, "soa components have no packed element to point to, check has<T>() and use get<T>()");
+
 			kw_assert(index < _capacity);
 			kw_assert(_vtable.type_info.is<T>());
 
@@ -393,7 +1048,7 @@ namespace kawa
 		{
 			struct config
 			{
-				registry& registry;
+				kawa::registry& registry;
 				bool flush_on_dtor = true; 
 				bool fifo = true;
 			};
@@ -538,26 +1193,77 @@ namespace kawa
 			string name = "unnamed";
 			usize max_entity_count = 128;
 			usize max_component_count = 128;
+			usize prefetch_distance = 8;
+			memory_resource* resource = default_memory_resource();
 		};
 
+		// frees storages handed out by _make_storage back to the resource they came from
+		struct _storage_deleter
+		{
+			void operator()(component_storage* s) const noexcept
+			{
+				s->~component_storage();
+				resource->deallocate(s, sizeof(component_storage), alignof(component_storage));
+			}
+
+			memory_resource* resource = nullptr;
+		};
+
+		using _storage_ptr = std::unique_ptr<component_storage, _storage_deleter>;
+		using _storage_array = std::vector<_storage_ptr, resource_allocator<_storage_ptr>>;
+
 		registry(const config& cfg)
-			: _cfg(cfg)
-			, _storages({ .capacity = cfg.max_component_count, .collision_depth = 16 })
-			, _free_list(cfg.max_entity_count)
-			, _entries(cfg.max_entity_count)
+			: _storages(resource_allocator<_storage_ptr>(cfg.resource))
+			, _storage_directory({ .capacity = cfg.max_component_count, .resource = cfg.resource })
+			, _free_list(cfg.max_entity_count, cfg.resource)
+			, _entries(cfg.max_entity_count, cfg.resource)
+			, _cfg(cfg)
+		{
+			_storages.reserve(cfg.max_component_count);
+		}
+
+		registry(const registry& other)
+			: registry(other._cfg)
 		{
+			*this = other;
 		}
 
-		registry(const registry& other) = default;
 		registry(registry&& other) = default;
 
-		registry& operator=(const registry& other) = default;
+		registry& operator=(const registry& other)
+		{
+			if (this != &other)
+			{
+				// the pointer array and the storages move over to the other registry's resource with its config
+				_storages = _storage_array(resource_allocator<_storage_ptr>(other._cfg.resource));
+				_storages.reserve(other._cfg.max_component_count);
+				_storages.resize(other._storages.size());
+
+				for (usize id = 0; id < other._storages.size(); id++)
+				{
+					if (other._storages[id])
+					{
+						_storages[id] = _make_storage(other._cfg.resource, *other._storages[id]);
+					}
+				}
+
+				_storage_directory = other._storage_directory;
+				_snapshot_file = other._snapshot_file;
+				_free_list = other._free_list;
+				_entries = other._entries;
+				_id_counter = other._id_counter;
+				_cfg = other._cfg;
+			}
+
+			return *this;
+		}
+
 		registry& operator=(registry&& other) = default;
 
 
-		usize entity_count()
+		usize entity_count() const noexcept
 		{
-			return _entries.occupied();
+			return _entries._occupied;
 		}
 
 		template<typename...Args>
@@ -567,8 +1273,9 @@ namespace kawa
 
 			if (!_free_list.empty())
 			{
-				id = _free_list[_free_list.occupied()];
-				_free_list.erase(_free_list.occupied());
+				usize top = _free_list.occupied() - 1;
+				id = _free_list[top];
+				_free_list.erase(top);
 			}
 			else if (_id_counter < _cfg.max_entity_count)
 			{
@@ -584,23 +1291,101 @@ namespace kawa
 			return id;
 		}
 
+		// can be called from many threads at once (e.g. from query_par workers), the storages of
+		// every emplaced component must already exist (see prepare), and no thread may destroy
+		// entities or create storages while concurrent creation is in progress, construct listeners
+		// run on the creating thread and batch listeners must not be connected to those storages
+		template<typename...Args>
+		entity_id entity_concurrent(Args&&...args)
+		{
+			entity_id id = _acquire_id_concurrent();
+
+			kw_assert(id.is_valid());
+
+			_entries.emplace_concurrent(id);
+
+			((emplace_concurrent<std::remove_cvref_t<Args>>(id, std::forward<Args>(args))), ...);
+
+			return id;
+		}
+
+		entity_id _acquire_id_concurrent() noexcept
+		{
+			std::atomic_ref<usize> free_top(_free_list._occupied);
+			usize top = free_top.load(std::memory_order_acquire);
+
+			while (top)
+			{
+				if (free_top.compare_exchange_weak(top, top - 1, std::memory_order_acq_rel))
+				{
+					usize slot = top - 1;
+					_free_list._mask[slot] = false;
+					return reinterpret_cast<entity_id*>(_free_list._storage)[slot];
+				}
+			}
+
+			std::atomic_ref<u64> counter(_id_counter.val);
+			u64 id = counter.load(std::memory_order_relaxed);
+
+			while (id < _cfg.max_entity_count)
+			{
+				if (counter.compare_exchange_weak(id, id + 1, std::memory_order_relaxed))
+				{
+					return id;
+				}
+			}
+
+			return {};
+		}
+
+		template<typename...Args>
+		void prepare()
+		{
+			((_lazy_get_storage<Args>()), ...);
+		}
+
 		template<typename T>
 		struct is_optional_arg
 		{
 			constexpr static bool value = std::is_pointer_v<T>;
 		};
 
+		template<typename T>
+		struct _is_defer_arg
+		{
+			constexpr static bool value = std::is_same_v<std::remove_cvref_t<T>, defer_buffer>;
+		};
+
 		template<typename T>
 		struct is_required_arg
 		{
-			constexpr static  bool value = std::is_reference_v<T>;
+			constexpr static  bool value = (std::is_reference_v<T> && !_is_defer_arg<T>::value) || _is_soa_ref<std::remove_cvref_t<T>>::value;
+		};
+
+		template<typename T>
+		struct _storage_type
+		{
+			using type = std::remove_cvref_t<T>;
+		};
+
+		template<typename T>
+			requires _is_soa_ref<std::remove_cvref_t<T>>::value
+		struct _storage_type<T>
+		{
+			using type = typename std::remove_cvref_t<T>::_soa_component;
 		};
 
 		template<typename T>
-		struct _not_entity_id : std::true_type {};
+		using _storage_type_t = typename _storage_type<T>::type;
+
+		template<typename T>
+		struct _not_entity_id : std::bool_constant<!std::is_same_v<T, entity_id>> {};
 
-		template<>
-		struct _not_entity_id<entity_id> : std::false_type {};
+		template<typename T>
+		struct _is_read_only_arg
+		{
+			constexpr static bool value = std::is_same_v<std::remove_cvref_t<T>, entity_id> || std::is_const_v<std::remove_pointer_t<std::remove_reference_t<T>>>;
+		};
 
 		template<typename Fn>
 		struct query_traits
@@ -609,9 +1394,19 @@ namespace kawa
 			using clear_args = meta::transform_each_t<std::remove_cvref_t, meta::transform_each_t<std::remove_pointer_t, dirty_args>>;
 
 			using require_args = meta::filter_tuple_t<_not_entity_id, meta::filter_tuple_t<is_required_arg, dirty_args>>;
-			using clean_require_args = meta::transform_each_t<std::remove_cvref_t, require_args>;
+			using clean_require_args = meta::transform_each_t<_storage_type_t, require_args>;
 
 			constexpr static bool has_required_components = std::tuple_size_v<clean_require_args> > 0;
+
+			constexpr static bool has_defer_args = []<typename...Args>(std::type_identity<tuple<Args...>>)
+			{
+				return (_is_defer_arg<Args>::value || ...);
+			}(std::type_identity<dirty_args>{});
+
+			constexpr static bool is_read_only = []<typename...Args>(std::type_identity<tuple<Args...>>)
+			{
+				return (_is_read_only_arg<Args>::value && ...);
+			}(std::type_identity<dirty_args>{});
 		};
 
 		template<typename Fn>
@@ -619,11 +1414,11 @@ namespace kawa
 		{		
 			for (auto e : _entries.as_base())
 			{
-				for (auto& s : _storages.values)
+				for (auto& s : _storages)
 				{
-					if (s.contains(e))
+					if (s && s->contains(e))
 					{
-						info_func(e, component_info{ s._vtable.type_info, ((u8*)s._storage) + s._vtable.type_info.size * e });
+						info_func(e, component_info{ s->_vtable.type_info, (void*)s->_element_bytes(e, s->_soa_scratch.data()) });
 					}
 				}
 			}
@@ -632,11 +1427,11 @@ namespace kawa
 		template<typename Fn>
 		void query_info_with(entity_id e, Fn&& info_func)
 		{
-			for (auto& s : _storages.values)
+			for (auto& s : _storages)
 			{
-				if (s.contains(e))
+				if (s && s->contains(e))
 				{
-					info_func(component_info{ s._vtable.type_info, ((u8*)s._storage) + s._vtable.type_info.size * e });
+					info_func(component_info{ s->_vtable.type_info, (void*)s->_element_bytes(e, s->_soa_scratch.data()) });
 				}
 			}
 		}
@@ -647,6 +1442,8 @@ namespace kawa
 		{
 			using q = query_traits<Fn>;
 
+			static_assert(!q::has_defer_args, "registry::defer_buffer& parameters are only provided by query_sharded");
+
 			if constexpr (q::has_required_components)
 			{
 				_query_required_impl<Fn,
@@ -674,61 +1471,254 @@ namespace kawa
 		template<typename Fn>
 		void query_with(entity_id id, Fn&& func)
 		{
-			kw_assert(id.is_valid());
-			kw_assert(_entries.contains(id));
+			query_with(span<const entity_id>(&id, 1), std::forward<Fn>(func));
+		}
 
+		template<typename Fn>
+		void query_with(span<const entity_id> ids, Fn&& func)
+		{
 			using q = query_traits<Fn>;
 
-			if constexpr (q::has_required_components)
-			{
-				_query_with_required_impl<Fn,
-					typename q::dirty_args,
-					typename q::clear_args,
-					typename q::clean_require_args
-				>(
-					std::make_index_sequence<std::tuple_size_v<typename q::dirty_args>>{},
-					std::make_index_sequence<std::tuple_size_v<typename q::clean_require_args>>{},
-					id,
-					std::forward<Fn>(func)
-				);
-			}
-			else
-			{
-				_query_with_no_required_impl<Fn,
-					typename q::dirty_args,
-					typename q::clear_args
-				>(
-					std::make_index_sequence<std::tuple_size_v<typename q::dirty_args>>{},
-					id,
-					std::forward<Fn>(func)
-				);
-			}
+			static_assert(!q::has_defer_args, "registry::defer_buffer& parameters are only provided by query_sharded");
+
+			_query_with_impl<Fn,
+				typename q::dirty_args,
+				typename q::clear_args,
+				typename q::clean_require_args
+			>(
+				std::make_index_sequence<std::tuple_size_v<typename q::dirty_args>>{},
+				std::make_index_sequence<std::tuple_size_v<typename q::clean_require_args>>{},
+				ids,
+				std::forward<Fn>(func)
+			);
 		}
 
+		// read-only queries never create storages, a missing required component yields nothing,
+		// so any number of them can run on the same registry from different threads at once
 		template<typename Fn>
-		void query_par(task_manager& tm, task_schedule_policy policy, usize work_groups, dyn_array<task_handle>& out_handles, Fn&& func)
+		void query(Fn&& func) const
 		{
 			using q = query_traits<Fn>;
 
-			if constexpr (q::has_required_components)
-			{
-				_query_par_with_required_impl<Fn,
-					typename q::dirty_args,
-					typename q::clear_args,
-					typename q::clean_require_args
-				>(
-					std::make_index_sequence<std::tuple_size_v<typename q::clear_args>>{},
-					std::make_index_sequence<std::tuple_size_v<typename q::clean_require_args>>{},
-					tm,
-					policy,
+			static_assert(q::is_read_only, "const queries can only take entity_id, const references and const pointers");
+
+			_query_read_only_impl<Fn,
+				typename q::dirty_args,
+				typename q::clean_require_args
+			>(
+				std::make_index_sequence<std::tuple_size_v<typename q::dirty_args>>{},
+				std::make_index_sequence<std::tuple_size_v<typename q::clean_require_args>>{},
+				span<const entity_id>{},
+				false,
+				std::forward<Fn>(func)
+			);
+		}
+
+		template<typename Fn>
+		void query_with(entity_id id, Fn&& func) const
+		{
+			query_with(span<const entity_id>(&id, 1), std::forward<Fn>(func));
+		}
+
+		template<typename Fn>
+		void query_with(span<const entity_id> ids, Fn&& func) const
+		{
+			using q = query_traits<Fn>;
+
+			static_assert(q::is_read_only, "const queries can only take entity_id, const references and const pointers");
+
+			_query_read_only_impl<Fn,
+				typename q::dirty_args,
+				typename q::clean_require_args
+			>(
+				std::make_index_sequence<std::tuple_size_v<typename q::dirty_args>>{},
+				std::make_index_sequence<std::tuple_size_v<typename q::clean_require_args>>{},
+				ids,
+				true,
+				std::forward<Fn>(func)
+			);
+		}
+
+		template<typename Fn>
+		void query_par(task_manager& tm, task_schedule_policy policy, usize work_groups, dyn_array<task_handle>& out_handles, Fn&& func)
+		{
+			using q = query_traits<Fn>;
+
+			_query_par_dispatch<q>(
+				tm,
+				policy,
+				work_groups,
+				out_handles,
+				[func = std::forward<Fn>(func)](usize) -> auto& { return func; }
+			);
+		}
+
+		template<typename T>
+		struct alignas(64) _reduce_slot
+		{
+			T value;
+		};
+
+		// map_fn takes the same parameters as a query_par callback and returns a value, every work group folds
+		// its slice into its own accumulator with combine_fn(T, value), the group results are then combined in
+		// group order on the calling thread, which blocks until the query is done
+		template<typename T, typename Fn, typename Combine>
+		T query_par_reduce(task_manager& tm, T identity, Fn&& map_fn, Combine&& combine_fn)
+		{
+			using q = query_traits<Fn>;
+
+			// one group folds everything on the calling thread when the manager has no workers
+			usize work_groups = std::max<usize>(tm.worker_count(), 1);
+
+			dyn_array<_reduce_slot<T>> slots(work_groups, _reduce_slot<T>{ identity });
+			dyn_array<task_handle> handles;
+			handles.reserve(work_groups);
+
+			_query_par_dispatch<q>(
+				tm,
+				task_schedule_policy::wait_if_neccesary,
+				work_groups,
+				handles,
+				[slots = slots.data(), &map_fn, &combine_fn](usize group_id)
+				{
+					return [slot = &slots[group_id].value, &map_fn, &combine_fn](auto&&...args)
+					{
+						*slot = combine_fn(std::move(*slot), map_fn(std::forward<decltype(args)>(args)...));
+					};
+				}
+			);
+
+			tm.wait(handles);
+
+			T out = std::move(identity);
+
+			for (auto& slot : slots)
+			{
+				out = combine_fn(std::move(out), std::move(slot.value));
+			}
+
+			return out;
+		}
+
+		// reproducible parallel query, [0, id counter) is cut into shard_count fixed id ranges that are
+		// each walked in ascending id order, so which entity lands in which shard and the order inside a
+		// shard only depend on the registry contents, a registry::defer_buffer& parameter receives the
+		// shard's own buffer, buffers are flushed in shard order once every shard is done
+		template<typename Fn>
+		void query_sharded(task_manager& tm, usize shard_count, Fn&& func)
+		{
+			using q = query_traits<Fn>;
+
+			kw_assert(shard_count);
+
+			_query_sharded_impl<Fn,
+				typename q::dirty_args,
+				typename q::clean_require_args
+			>(
+				std::make_index_sequence<std::tuple_size_v<typename q::dirty_args>>{},
+				std::make_index_sequence<std::tuple_size_v<typename q::clean_require_args>>{},
+				tm,
+				shard_count,
+				std::forward<Fn>(func)
+			);
+		}
+
+		template<
+			typename Fn,
+			typename dirty_args_tuple,
+			typename require_tuple,
+			usize...args_idxs,
+			usize...require_idxs
+		>
+		void _query_sharded_impl(
+			std::index_sequence<args_idxs...>,
+			std::index_sequence<require_idxs...>,
+			task_manager& mgr,
+			usize shard_count,
+			Fn&& func
+		) {
+			auto getters = std::make_tuple(
+				_make_query_param_getter<std::tuple_element_t<args_idxs, dirty_args_tuple>>(
+					*this
+				)()...
+			);
+
+			// entities without components are only filtered by the entry mask
+			auto masks = [&]()
+			{
+				if constexpr (sizeof...(require_idxs) > 0)
+				{
+					return array<bool*, sizeof...(require_idxs)>{ _lazy_get_storage<std::tuple_element_t<require_idxs, require_tuple>>()._mask... };
+				}
+				else
+				{
+					return array<bool*, 1>{ _entries._mask };
+				}
+			}();
+
+			dyn_array<defer_buffer> buffers;
+			buffers.reserve(shard_count);
+
+			for (usize i = 0; i < shard_count; i++)
+			{
+				buffers.emplace_back(defer(false));
+			}
+
+			dyn_array<task_handle> handles;
+			handles.reserve(shard_count);
+
+			defer_buffer* shard_buffers = buffers.data();
+
+			_schedule_slices(mgr, task_schedule_policy::wait_if_neccesary, shard_count, _id_counter, handles,
+				[=](usize shard, usize begin, usize end)
+				{
+					auto shard_getters = getters;
+
+					std::apply([&](auto&...getter) { (_bind_defer(getter, shard_buffers + shard), ...); }, shard_getters);
+
+					_query_id_range(
+						std::index_sequence<args_idxs...>{},
+						begin,
+						end,
+						masks,
+						shard_getters,
+						func
+					);
+				}
+			);
+
+			mgr.wait(handles);
+
+			for (auto& buffer : buffers)
+			{
+				buffer.flush();
+			}
+		}
+
+		template<typename q, typename GroupFn>
+		void _query_par_dispatch(task_manager& tm, task_schedule_policy policy, usize work_groups, dyn_array<task_handle>& out_handles, GroupFn&& group_fn)
+		{
+			static_assert(!q::has_defer_args, "registry::defer_buffer& parameters are only provided by query_sharded");
+
+			if constexpr (q::has_required_components)
+			{
+				_query_par_with_required_impl<GroupFn,
+					typename q::dirty_args,
+					typename q::clear_args,
+					typename q::clean_require_args
+				>(
+					std::make_index_sequence<std::tuple_size_v<typename q::clear_args>>{},
+					std::make_index_sequence<std::tuple_size_v<typename q::clean_require_args>>{},
+					tm,
+					policy,
 					work_groups,
 					out_handles,
-					std::forward<Fn>(func)
+					std::forward<GroupFn>(group_fn)
 				);
 			}
 			else
 			{
-				_query_par_with_no_required_impl<Fn,
+				_query_par_with_no_required_impl<GroupFn,
 					typename q::dirty_args,
 					typename q::clear_args
 				>(
@@ -737,92 +1727,156 @@ namespace kawa
 					policy,
 					work_groups,
 					out_handles,
-					std::forward<Fn>(func)
+					std::forward<GroupFn>(group_fn)
 				);
 			}
 		}
 
-		struct _entity_id_getter 
+		// only query_sharded binds a buffer, one per shard
+		struct _defer_getter
 		{
-			inline entity_id get(usize i) const noexcept
+			defer_buffer* _buffer = nullptr;
+
+			inline defer_buffer& get(usize) const noexcept
 			{
-				return i;
+				kw_assert_msg(_buffer, "{}", "defer_buffer parameters are only provided by query_sharded");
+				return *_buffer;
 			}
+
+			inline void prefetch(usize) const noexcept {}
 		};
 
 		template<typename T>
-		struct _required_getter
+		struct _make_query_param_getter
 		{
-			T* _data;
+			registry& r;
 
-			inline T& get(usize i) const noexcept
+			auto operator()(usize worker_count = 1) const noexcept
 			{
-				return _data[i];
-			}
-		};
+				using CVT = std::remove_reference_t<std::remove_pointer_t<T>>;
+				using CleanT = std::remove_cv_t<CVT>;
 
-		template<typename T>
-		struct _optional_getter
-		{
-			T* _data;       
-			bool* _mask;    
+				if constexpr (std::is_same_v<entity_id, T>)
+				{
+					return _entity_id_getter{};
+				}
+				else if constexpr (_is_soa_ref<std::remove_cvref_t<T>>::value)
+				{
+					using C = typename std::remove_cvref_t<T>::_soa_component;
 
-			inline T* get(usize i) const noexcept
-			{
-				if (_mask[i]) 
+					auto& s = r._lazy_get_storage<C>();
+					return _soa_getter<C>{ _soa_traits<C>::bases(s._storage, s._capacity) };
+				}
+				else if constexpr (std::is_pointer_v<T>)
+				{
+					static_assert(!is_soa_v<CleanT>, "soa components are queried through soa<T> proxies");
+					static_assert(!_is_soa_ref<CleanT>::value, "soa<T> proxies can't be optional, query them as required or check has<T>() and use get<T>()");
+
+					auto& s = r._lazy_get_storage<CleanT>();
+					return _optional_getter<CVT>{ (CVT*)s._storage, s._mask};
+				}
+				else if constexpr (_is_defer_arg<T>::value)
+				{
+					return _defer_getter{};
+				}
+				else if constexpr (std::is_reference_v<T>)
 				{
-					return _data + i;
+					static_assert(!is_soa_v<CleanT>, "soa components are queried through soa<T> proxies");
+
+					auto& s = r._lazy_get_storage<CleanT>();
+					return _required_getter<CVT>{ (CVT*)s._storage };
 				}
-				return nullptr;
 			}
 		};
-	
+
 		template<typename T>
-		struct _make_query_param_getter
+		struct _make_read_only_query_param_getter
 		{
-			registry& r;
+			const registry& r;
 
-			auto operator()(usize worker_count = 1) const noexcept
+			auto operator()() const noexcept
 			{
 				using CVT = std::remove_reference_t<std::remove_pointer_t<T>>;
 				using CleanT = std::remove_cv_t<CVT>;
 
-				if constexpr (std::is_same_v<entity_id, T>)
+				if constexpr (std::is_same_v<entity_id, std::remove_cvref_t<T>>)
 				{
 					return _entity_id_getter{};
 				}
 				else if constexpr (std::is_pointer_v<T>)
 				{
-					auto& s = r._lazy_get_storage<CleanT>();
-					return _optional_getter<CVT>{ (CVT*)s._storage, s._mask};
+					static_assert(!is_soa_v<CleanT> && !_is_soa_ref<CleanT>::value, "soa components are queried through soa<T> proxies, which can't be optional");
+
+					const component_storage* s = r._try_get_storage<CleanT>();
+					return _nullable_optional_getter<CVT>{ s ? (CVT*)s->_storage : nullptr, s ? s->_mask : nullptr };
 				}
 				else if constexpr (std::is_reference_v<T>)
 				{
-					auto& s = r._lazy_get_storage<CleanT>();
-					return _required_getter<CVT>{ (CVT*)s._storage };
+					const component_storage* s = r._try_get_storage<CleanT>();
+					return _required_getter<CVT>{ s ? (CVT*)s->_storage : nullptr };
 				}
 			}
 		};
 
 
+		template<typename getter_t>
+		static inline void _bind_defer(getter_t& getter, defer_buffer* buffer) noexcept
+		{
+			if constexpr (std::is_same_v<getter_t, _defer_getter>)
+			{
+				getter._buffer = buffer;
+			}
+		}
+
 		template<
 			typename Fn,
 			typename dirty_args_tuple,
-			typename args_tuple,
-			usize...args_idxs
+			typename require_tuple,
+			usize...args_idxs,
+			usize...require_idxs
 		>
-		void _query_with_no_required_impl(
+		void _query_read_only_impl(
 			std::index_sequence<args_idxs...>,
-			entity_id i,
+			std::index_sequence<require_idxs...>,
+			span<const entity_id> ids,
+			bool with_ids,
 			Fn&& func
-		) {
+		) const {
+			array<const component_storage*, sizeof...(require_idxs)> required_storages = {
+				_try_get_storage<std::tuple_element_t<require_idxs, require_tuple>>()...
+			};
+
+			for (auto s : required_storages)
+			{
+				if (!s) return;
+			}
+
 			auto getters = std::make_tuple(
-				_make_query_param_getter<std::tuple_element_t<args_idxs, dirty_args_tuple>>(*this)()...
+				_make_read_only_query_param_getter<std::tuple_element_t<args_idxs, dirty_args_tuple>>{ *this }()...
 			);
 
-			std::forward<Fn>(func)(
-				std::get<args_idxs>(getters).get(i)...
-			);
+			if (with_ids)
+			{
+				array<const bool*, sizeof...(require_idxs)> required_storage_masks;
+
+				for (usize i = 0; i < sizeof...(require_idxs); i++)
+				{
+					required_storage_masks[i] = required_storages[i]->_mask;
+				}
+
+				_query_range(std::index_sequence<args_idxs...>{}, ids.data(), 0, ids.size(), _cfg.prefetch_distance, required_storage_masks, getters, func);
+			}
+			else if constexpr (sizeof...(require_idxs) == 0)
+			{
+				_query_range(std::index_sequence<args_idxs...>{}, _entries._indirect_map, 0, _entries._occupied, _cfg.prefetch_distance, array<const bool*, 0>{}, getters, func);
+			}
+			else
+			{
+				array<const bool*, sizeof...(require_idxs) - 1> required_storage_masks;
+				const component_storage* driver = _select_driver(required_storages, required_storage_masks);
+
+				_query_range(std::index_sequence<args_idxs...>{}, driver->_indirect_map, 0, driver->_occupied, _cfg.prefetch_distance, required_storage_masks, getters, func);
+			}
 		}
 
 		template<
@@ -833,10 +1887,10 @@ namespace kawa
 			usize...args_idxs,
 			usize...require_idxs
 		>
-		void _query_with_required_impl(
+		void _query_with_impl(
 			std::index_sequence<args_idxs...>,
 			std::index_sequence<require_idxs...>,
-			entity_id i,
+			span<const entity_id> ids,
 			Fn&& func
 		) {
 			auto getters = std::make_tuple(
@@ -849,14 +1903,16 @@ namespace kawa
 				_lazy_get_storage<std::tuple_element_t<require_idxs, require_tuple>>()._mask...
 			};
 
-			if ([&]<usize...I>(std::index_sequence<I...>) {
-				return (... && required_storage_masks[I][i]);
-			}(std::make_index_sequence<sizeof...(require_idxs) - 1>{}))
-			{
-				func(
-					std::get<args_idxs>(getters).get(i)...
-				);
-			}
+			_query_range(
+				std::index_sequence<args_idxs...>{},
+				ids.data(),
+				0,
+				ids.size(),
+				_cfg.prefetch_distance,
+				required_storage_masks,
+				getters,
+				func
+			);
 		}
 
 		template<
@@ -873,12 +1929,16 @@ namespace kawa
 				_make_query_param_getter<std::tuple_element_t<args_idxs, dirty_args_tuple>>(*this)()...
 			);
 
-			for (auto i : _entries.as_base())
-			{
-				std::forward<Fn>(func)(
-					std::get<args_idxs>(getters).get(i)...
-				);
-			}
+			_query_range(
+				std::index_sequence<args_idxs...>{},
+				_entries._indirect_map,
+				0,
+				_entries._occupied,
+				_cfg.prefetch_distance,
+				array<bool*, 0>{},
+				getters,
+				func
+			);
 		}
 
 		template<
@@ -904,41 +1964,22 @@ namespace kawa
 				&_lazy_get_storage<std::tuple_element_t<require_idxs, require_tuple>>()... 
 			};
 
-			usize driver_index = 0;
-
-			for (usize i = 0; i < required_storages.size(); i++)
-			{
-				if (required_storages[i]->_occupied < 
-					required_storages[driver_index]->_occupied)
-				{
-					driver_index = i;
-				}
-			}
-
-			component_storage& driver = *required_storages[driver_index];
-
-			required_storages[driver_index] = required_storages[sizeof...(require_idxs) - 1];
-
 			array<bool*, sizeof...(require_idxs) - 1> required_storage_masks;
-
-			for (usize i = 0; i < sizeof...(require_idxs) - 1; i++)
-			{
-				required_storage_masks[i] = required_storages[i]->_mask;
-			}
-
-			for (auto i : driver)
-			{
-				if ([&]<usize...I>(std::index_sequence<I...>) { 
-					return (... && required_storage_masks[I][i]);
-				}(std::make_index_sequence<sizeof...(require_idxs) - 1>{}))
-				{
-					func(
-						std::get<args_idxs>(getters).get(i)...
-					);
-				}
-			}
+			component_storage* driver = _select_driver(required_storages, required_storage_masks);
+
+			_query_range(
+				std::index_sequence<args_idxs...>{},
+				driver->_indirect_map,
+				0,
+				driver->_occupied,
+				_cfg.prefetch_distance,
+				required_storage_masks,
+				getters,
+				func
+			);
 		}
 
+		// group_fn(group_id) hands out the callable a slice invokes for each matching entity
 		template<
 			typename Fn,
 			typename dirty_args_tuple,
@@ -954,7 +1995,7 @@ namespace kawa
 			task_schedule_policy policy,
 			usize work_gouprs,
 			dyn_array<task_handle>& out_handles,
-			Fn&& func
+			Fn&& group_fn
 		) {
 			auto getters = std::make_tuple(
 				_make_query_param_getter<std::tuple_element_t<args_idxs, dirty_args_tuple>>(
@@ -963,57 +2004,27 @@ namespace kawa
 			);
 			array<component_storage*, sizeof...(require_idxs)> required_storages = { &_lazy_get_storage<std::tuple_element_t<require_idxs, require_tuple>>()... };
 
-			usize driver_index = 0;
-
-			for (usize i = 0; i < required_storages.size(); i++)
-			{
-				if (required_storages[i]->_occupied < required_storages[driver_index]->_occupied)
-				{
-					driver_index = i;
-				}
-			}
-
-			component_storage* driver = required_storages[driver_index];
-
-			required_storages[driver_index] = required_storages[sizeof...(require_idxs) - 1];
-
 			array<bool*, sizeof...(require_idxs) - 1> required_storage_masks;
+			component_storage* driver = _select_driver(required_storages, required_storage_masks);
 
-			for (usize i = 0; i < sizeof...(require_idxs) - 1; i++)
-			{
-				required_storage_masks[i] = required_storages[i]->_mask;
-			}
-
-			usize work_reminder = driver->_occupied % work_gouprs;
-			usize work_per_group = driver->_occupied / work_gouprs;
-
-			for (usize group_id = 0; group_id < work_gouprs; group_id++)
-			{
-				usize current_group_work = ((group_id == work_gouprs - 1) ? work_reminder + work_per_group : work_per_group);
-				out_handles.emplace_back(
-					mgr.schedule(
-						[=]()
-						{
-							auto map = driver->_indirect_map;
-							usize i;
-							for (usize e = 0; e < current_group_work; e++)
-							{
-								i = map[(group_id * work_per_group) + e];
+			const usize* map = driver->_indirect_map;
+			usize prefetch_distance = _cfg.prefetch_distance;
 
-								if ([&]<usize...I>(std::index_sequence<I...>) 
-								{ return (... && required_storage_masks[I][i]); }
-								(std::make_index_sequence<sizeof...(require_idxs) - 1>{}))
-								{
-									func(
-										std::get<args_idxs>(getters).get(i)...
-									);
-								}
-							}
-						}
-						, policy
-					)
-				);
-			}
+			_schedule_slices(mgr, policy, work_gouprs, driver->_occupied, out_handles,
+				[=](usize group_id, usize begin, usize end)
+				{
+					_query_range(
+						std::index_sequence<args_idxs...>{},
+						map,
+						begin,
+						end,
+						prefetch_distance,
+						required_storage_masks,
+						getters,
+						group_fn(group_id)
+					);
+				}
+			);
 		}
 
 		template<
@@ -1028,82 +2039,157 @@ namespace kawa
 			task_schedule_policy policy,
 			usize work_gouprs,
 			dyn_array<task_handle>& out_handles,
-			Fn&& func
+			Fn&& group_fn
 		){
 			auto getters = std::make_tuple(
 				_make_query_param_getter<std::tuple_element_t<args_idxs, dirty_args_tuple>>(
 					*this
 				)()...
 			);
-			usize work_reminder = _entries.as_base()._occupied % work_gouprs;
-			usize work_per_group = _entries.as_base()._occupied / work_gouprs;
 
-			dyn_array<defer_buffer> defer_buffers;
-			defer_buffers.reserve(work_gouprs);
+			const usize* map = _entries._indirect_map;
+			usize prefetch_distance = _cfg.prefetch_distance;
 
-			for (usize group_id = 0; group_id < work_gouprs; group_id++)
-			{
-				out_handles.emplace_back(
-					mgr.schedule(
-						[=]()
-						{
-							auto map = _entries._indirect_map;
-
-							for (usize e = 0; e < (group_id == work_gouprs - 1) ? work_reminder + work_per_group : work_per_group; e++)
-							{
-								auto i = map[(group_id + work_per_group) + e];
-
-								func(
-									std::get<args_idxs>(getters).get(i)...
-								);
-							}
-						}
-						, policy
-					)
-				);
-			}		
+			_schedule_slices(mgr, policy, work_gouprs, _entries._occupied, out_handles,
+				[=](usize group_id, usize begin, usize end)
+				{
+					_query_range(
+						std::index_sequence<args_idxs...>{},
+						map,
+						begin,
+						end,
+						prefetch_distance,
+						array<bool*, 0>{},
+						getters,
+						group_fn(group_id)
+					);
+				}
+			);
 		}
 		
+		// every call adds another listener, the returned id can be used to remove it again
 		template<typename Fn>
-		void on_construct(Fn&& func)
+		usize on_construct(Fn&& func)
 		{
 			static_assert(std::is_same_v<typename meta::function_traits<Fn>::template arg_at<0>, entity_id>, "lifetime hook callbacks require first parameter to be entity id");
 
 			using T = std::remove_cvref_t<typename meta::function_traits<Fn>::template arg_at<1>>;
 
-			_lazy_get_storage<T>().set_on_construct<Fn>(std::forward<Fn>(func));
+			return _lazy_get_storage<T>().add_on_construct(std::forward<Fn>(func));
 		}
 
 		template<typename Fn>
-		void on_destruct(Fn&& func)
+		usize on_destruct(Fn&& func)
 		{
 			static_assert(std::is_same_v<typename meta::function_traits<Fn>::template arg_at<0>, entity_id>, "lifetime hook callbacks require first parameter to be entity id");
 
 			using T = std::remove_cvref_t<typename meta::function_traits<Fn>::template arg_at<1>>;
 
-			_lazy_get_storage<T>().set_on_destruct<Fn>(std::forward<Fn>(func));
+			return _lazy_get_storage<T>().add_on_destruct(std::forward<Fn>(func));
 		}
 
-		template<typename T>
-		T& add(entity_id index, T&& v)
+		// batch listeners receive every entity that got a T (or lost it) since the last flush_events,
+		// by the time they run the component may already be gone again, check before touching it
+		template<typename T, typename Fn>
+		usize on_construct_batch(Fn&& func)
 		{
-			return _lazy_get_storage<std::remove_cvref_t<T>>().emplace<std::remove_cvref_t<T>>(index, std::forward<T>(v));
+			return _lazy_get_storage<T>().on_construct_signal.connect_batch(std::forward<Fn>(func));
 		}
 
-		template<typename T, typename...Args>
-		T& emplace(entity_id index, Args&&...args)
+		template<typename T, typename Fn>
+		usize on_destruct_batch(Fn&& func)
 		{
-			return _lazy_get_storage<T>().emplace<T>(index, std::forward<Args>(args)...);
+			return _lazy_get_storage<T>().on_destruct_signal.connect_batch(std::forward<Fn>(func));
 		}
 
-		template<typename...Args>
-		void erase(entity_id e)
+		void flush_events()
 		{
-			((_lazy_get_storage<Args>().erase(e)), ...);
+			for (usize id = 0; id < _storages.size(); id++)
+			{
+				if (component_storage* s = _storages[id].get())
+				{
+					s->on_construct_signal.flush();
+					s->on_destruct_signal.flush();
+				}
+			}
 		}
 
-		template<typename...Args>
-		void copy(entity_id from, entity_id to)
+		// channels are created on first use, do that before sending from several threads at once,
+		// events are frame local and are not carried over when the registry is copied
+		template<typename T>
+		event_channel<T>& events()
+		{
+			usize id = event_type_id<T>();
+
+			if (id >= _event_channels.size())
+			{
+				_event_channels.resize(id + 1);
+			}
+
+			if (!_event_channels[id])
+			{
+				_event_channels[id] = std::make_unique<event_channel<T>>();
+			}
+
+			return static_cast<event_channel<T>&>(*_event_channels[id]);
+		}
+
+		template<typename T, typename...Args>
+		T& send(Args&&...args)
+		{
+			return events<T>().send(std::forward<Args>(args)...);
+		}
+
+		// once per frame, makes everything sent since the previous swap readable
+		void swap_events() noexcept
+		{
+			for (auto& c : _event_channels)
+			{
+				if (c)
+				{
+					c->swap();
+				}
+			}
+		}
+
+		template<typename T>
+		bool remove_on_construct(usize listener)
+		{
+			return _lazy_get_storage<T>().on_construct_signal.disconnect(listener);
+		}
+
+		template<typename T>
+		bool remove_on_destruct(usize listener)
+		{
+			return _lazy_get_storage<T>().on_destruct_signal.disconnect(listener);
+		}
+
+		template<typename T>
+		component_ref<std::remove_cvref_t<T>> add(entity_id index, T&& v)
+		{
+			return _lazy_get_storage<std::remove_cvref_t<T>>().template emplace<std::remove_cvref_t<T>>(index, std::forward<T>(v));
+		}
+
+		template<typename T, typename...Args>
+		component_ref<T> emplace(entity_id index, Args&&...args)
+		{
+			return _lazy_get_storage<T>().template emplace<T>(index, std::forward<Args>(args)...);
+		}
+
+		template<typename T, typename...Args>
+		component_ref<T> emplace_concurrent(entity_id index, Args&&...args)
+		{
+			return _get_storage<T>().template emplace_concurrent<T>(index, std::forward<Args>(args)...);
+		}
+
+		template<typename...Args>
+		void erase(entity_id e)
+		{
+			((_lazy_get_storage<Args>().erase(e)), ...);
+		}
+
+		template<typename...Args>
+		void copy(entity_id from, entity_id to)
 		{
 			((_lazy_get_storage<Args>().copy(from, to)), ...);
 		}
@@ -1116,11 +2202,11 @@ namespace kawa
 
 		void clone(entity_id from, entity_id to)
 		{
-			for (auto& s : _storages.values	)
+			for (auto& s : _storages)
 			{
-				if (s.contains(from))
+				if (s && s->contains(from))
 				{
-					s.copy(from, to);
+					s->copy(from, to);
 				}
 			}
 		}
@@ -1134,38 +2220,191 @@ namespace kawa
 			return to;
 		}
 
+		dyn_array<entity_id> migrate(registry& other, span<const entity_id> ids)
+		{
+			kw_assert(this != &other);
+
+			dyn_array<entity_id> out;
+			out.reserve(ids.size());
+
+			// a repeated id maps to the entity made for its first occurrence and is only moved once
+			hash_map<usize> first_index({ .capacity = ids.size(), .resource = _cfg.resource });
+			dyn_array<usize> unique_ids;
+			unique_ids.reserve(ids.size());
+
+			for (usize k = 0; k < ids.size(); k++)
+			{
+				kw_assert(_entries.contains(ids[k]));
+
+				if (const usize* first = first_index.try_get(ids[k]))
+				{
+					out.emplace_back(out[*first]);
+					continue;
+				}
+
+				first_index.insert(ids[k], k);
+				unique_ids.emplace_back(k);
+				out.emplace_back(other.entity());
+			}
+
+			for (usize id = 0; id < _storages.size(); id++)
+			{
+				component_storage* src = _storages[id].get();
+
+				if (!src || !src->_occupied) continue;
+
+				component_storage* dst = other._try_get_storage(id);
+
+				for (usize k : unique_ids)
+				{
+					if (!src->contains(ids[k])) continue;
+
+					if (!dst)
+					{
+						dst = &other._emplace_storage_like(id, *src);
+					}
+
+					src->_relocate_to(*dst, ids[k], out[k]);
+				}
+			}
+
+			for (usize k : unique_ids)
+			{
+				destroy(ids[k]);
+			}
+
+			return out;
+		}
+
 		template<typename T>
-		T& get(entity_id e)
+		component_ref<T> get(entity_id e)
+		{
+			return _lazy_get_storage<T>().template get<T>(e);
+		}
+
+		// whole field array of a soa component indexed by entity id, only the slots of entities
+		// that have the component hold meaningful values
+		template<auto member>
+		auto field_span()
 		{
-			return _lazy_get_storage<T>().get<T>(e);
+			using T = typename _member_traits<decltype(member)>::class_t;
+			using V = typename _member_traits<decltype(member)>::value_t;
+
+			static_assert(is_soa_v<T>, "field_span requires a soa component");
+
+			constexpr usize field = _soa_traits<T>::template index_of<member>();
+
+			static_assert(field < _soa_traits<T>::field_count, "member is not one of the soa fields");
+
+			component_storage& s = _lazy_get_storage<T>();
+
+			return span<V>(reinterpret_cast<V*>(s._soa_field(field, 0)), s._capacity);
 		}
 
 		//template<typename...Args>
 		//tuple<Args&...> get(entity_id e)
 		//{
-		//	return std::forward_as_tuple(_lazy_get_storage<Args>().get<Args>(e)...);
+		//	return std::forward_as_tuple(_lazy_get_storage<Args>().template get<Args>(e)...);
 		//}
 
+		template<typename T>
+		const T& get(entity_id e) const
+		{
+			const component_storage* s = _try_get_storage<T>();
+			kw_assert_msg(s, "storage for {} does not exist", meta::type_name<T>());
+			return s->get<T>(e);
+		}
+
 		template<typename T>
 		T* try_get(entity_id e)
 		{
-			return _lazy_get_storage<T>().try_get<T>(e);
+			return _lazy_get_storage<T>().template try_get<T>(e);
+		}
+
+		template<typename T>
+		const T* try_get(entity_id e) const
+		{
+			const component_storage* s = _try_get_storage<T>();
+			return s ? s->try_get<T>(e) : nullptr;
 		}
 
 		//template<typename...Args>
 		//tuple<Args*...> try_get(entity_id e)
 		//{
-		//	return std::forward_as_tuple(_lazy_get_storage<Args>().try_get<Args>(e)...);
+		//	return std::forward_as_tuple(_lazy_get_storage<Args>().template try_get<Args>(e)...);
 		//}
 
 		void destroy(entity_id id)
 		{
 			if (!_entries.contains(id)) return;
 
-			for (auto& s : _storages.values)
+			for (auto& s : _storages)
+			{
+				if (s)
+				{
+					s->erase(id);
+				}
+			}
+
+			_entries.erase(id);
+			_free_list.emplace(_free_list.occupied(), id);
+		}
+
+		// renumbers the live entities into [0, entity_count()) keeping their order, so storages are dense
+		// again after heavy churn, remap(from, to) is called for every entity whose id changed once all
+		// components have been moved, pending batch events are flushed beforehand with the old ids
+		template<typename Fn>
+		void compact(Fn&& remap)
+		{
+			static_assert(std::is_invocable_v<Fn&, entity_id, entity_id>, "compact callbacks require (entity_id from, entity_id to) parameters");
+
+			flush_events();
+
+			usize end = _id_counter;
+
+			dyn_array<entity_id> ids(end);
+			usize live = 0;
+
+			for (usize e = 0; e < end; e++)
 			{
-				s.erase(id);
+				if (_entries.contains(e))
+				{
+					ids[e] = live++;
+				}
 			}
+
+			if (live == end) return;
+
+			for (auto& s : _storages)
+			{
+				if (s)
+				{
+					s->_compact(ids.data(), end);
+				}
+			}
+
+			_entries.clear();
+			_free_list.clear();
+
+			for (usize e = 0; e < live; e++)
+			{
+				_entries.emplace(e);
+			}
+
+			_id_counter = live;
+
+			for (usize e = 0; e < end; e++)
+			{
+				if (ids[e].is_valid() && ids[e] != e)
+				{
+					remap(entity_id(e), ids[e]);
+				}
+			}
+		}
+
+		void compact()
+		{
+			compact([](entity_id, entity_id) {});
 		}
 
 		template<typename...Args>
@@ -1174,27 +2413,598 @@ namespace kawa
 			return ((_lazy_get_storage<Args>().contains(e)) && ...);
 		}
 
+		template<typename...Args>
+		bool has(entity_id e) const noexcept
+		{
+			return ([&]() { const component_storage* s = _try_get_storage<Args>(); return s && s->contains(e); }() && ...);
+		}
+
+		// mapped storages live in the snapshot file, their bytes are reported but only
+		// the pages that were written to are backed by private memory
+		memory_report_info memory_report() const
+		{
+			memory_report_info out;
+
+			for (auto& s : _storages)
+			{
+				if (!s) continue;
+
+				storage_memory_info& info = out.storages.emplace_back();
+
+				info.type_name = s->_vtable.type_info.name;
+				info.occupied = s->_occupied;
+				info.capacity = s->_capacity;
+				info.data_bytes = s->_capacity * s->_vtable.type_info.size;
+				info.metadata_bytes = s->_metadata_bytes();
+				info.fill_ratio = s->_capacity ? (f32)s->_occupied / (f32)s->_capacity : 0.0f;
+				info.mapped = s->_mapped;
+
+				out.data_bytes += info.data_bytes;
+				out.metadata_bytes += info.metadata_bytes;
+				out.directory_bytes += sizeof(component_storage);
+			}
+
+			out.entity_bytes = _entries.memory_usage() + _free_list.memory_usage();
+			out.directory_bytes += _storage_directory.memory_usage() + _storages.capacity() * sizeof(_storage_ptr);
+			out.total_bytes = out.data_bytes + out.metadata_bytes + out.entity_bytes + out.directory_bytes;
+
+			return out;
+		}
+
 		defer_buffer defer(bool flush_on_dtor = true, bool fifo = true)
 		{
 			return { {*this, flush_on_dtor, fifo} };
 		}
 
+		struct _snapshot_header
+		{
+			constexpr static u64 magic_value = 0x31304e5341574b41; // "KAWASN01"
+
+			u64 magic = magic_value;
+			u64 usize_size = sizeof(usize);
+			u64 max_entity_count = 0;
+			u64 id_counter = 0;
+			u64 section_count = 0;
+		};
+
+		struct _snapshot_section
+		{
+			u64 type_hash = 0;
+			u64 element_size = 0;
+			u64 occupied = 0;
+			u64 storage_offset = 0;
+			u64 mask_offset = 0;
+			u64 indirect_map_offset = 0;
+			u64 reverse_indirect_map_offset = 0;
+		};
+
+		void save_snapshot(const string& path)
+		{
+			dyn_array<pair<indirect_array_base*, meta::type_info>> sources;
+
+			sources.emplace_back(&_entries.as_base(), meta::type_info(meta::construct_tag<entity_id>{}));
+			sources.emplace_back(&_free_list.as_base(), meta::type_info(meta::construct_tag<entity_id>{}));
+
+			for (auto& s : _storages)
+			{
+				if (s)
+				{
+					kw_verify_msg(s->_vtable.type_info.trivially_copyable, "snapshot requires trivially copyable components, got: {}", s->_vtable.type_info.name);
+					sources.emplace_back(&s->as_base(), s->_vtable.type_info);
+				}
+			}
+
+			auto align_up = [](usize v, usize a) { return (v + a - 1) & ~(a - 1); };
+
+			_snapshot_header header{
+				.max_entity_count = _cfg.max_entity_count,
+				.id_counter = _id_counter,
+				.section_count = sources.size()
+			};
+
+			dyn_array<_snapshot_section> sections(sources.size());
+
+			usize capacity = _cfg.max_entity_count;
+			usize offset = sizeof(_snapshot_header) + sizeof(_snapshot_section) * sections.size();
+
+			for (usize i = 0; i < sources.size(); i++)
+			{
+				auto& [src, info] = sources[i];
+				auto& sec = sections[i];
+
+				sec.type_hash = info.hash;
+				sec.element_size = info.size;
+				sec.occupied = src->_occupied;
+
+				offset = align_up(offset, std::max<usize>(64, info.alignment));
+				sec.storage_offset = offset;
+				offset += capacity * info.size;
+
+				offset = align_up(offset, 64);
+				sec.mask_offset = offset;
+				offset += capacity * sizeof(bool);
+
+				offset = align_up(offset, 64);
+				sec.indirect_map_offset = offset;
+				offset += capacity * sizeof(usize);
+
+				offset = align_up(offset, 64);
+				sec.reverse_indirect_map_offset = offset;
+				offset += capacity * sizeof(usize);
+			}
+
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+			kw_verify_msg(file.is_open(), "failed to open file: {}", path);
+
+			usize written = 0;
+
+			auto write_at = [&](usize at, const void* data, usize size)
+				{
+					constexpr static char zeros[64]{};
+
+					while (written < at)
+					{
+						usize n = std::min<usize>(sizeof(zeros), at - written);
+						file.write(zeros, n);
+						written += n;
+					}
+
+					file.write((const char*)data, size);
+					written += size;
+				};
+
+			write_at(0, &header, sizeof(header));
+			write_at(written, sections.data(), sizeof(_snapshot_section) * sections.size());
+
+			for (usize i = 0; i < sources.size(); i++)
+			{
+				auto src = sources[i].first;
+				auto& sec = sections[i];
+
+				write_at(sec.storage_offset, src->_storage, capacity * sec.element_size);
+				write_at(sec.mask_offset, src->_mask, capacity * sizeof(bool));
+				write_at(sec.indirect_map_offset, src->_indirect_map, capacity * sizeof(usize));
+				write_at(sec.reverse_indirect_map_offset, src->_reverse_indirect_map, capacity * sizeof(usize));
+			}
+
+			kw_verify_msg(file.good(), "failed to write snapshot: {}", path);
+		}
+
+		template<typename...Components>
+		void load_snapshot(const string& path)
+		{
+			static_assert((std::is_trivially_copyable_v<Components> && ...), "snapshot components must be trivially copyable");
+
+			auto file = std::make_shared<mapped_file>(path);
+
+			kw_verify_msg(file->is_open(), "failed to map file: {}", path);
+			kw_verify_msg(file->size() >= sizeof(_snapshot_header), "invalid snapshot: {}", path);
+
+			u8* base = file->data();
+
+			auto& header = *reinterpret_cast<_snapshot_header*>(base);
+
+			kw_verify_msg(header.magic == _snapshot_header::magic_value && header.usize_size == sizeof(usize), "invalid snapshot: {}", path);
+			kw_verify_msg(header.max_entity_count == _cfg.max_entity_count, "snapshot entity capacity mismatch, got: {} expected: {}", header.max_entity_count, _cfg.max_entity_count);
+			kw_verify_msg(header.section_count >= 2, "invalid snapshot: {}", path);
+			kw_verify_msg(header.section_count <= (file->size() - sizeof(_snapshot_header)) / sizeof(_snapshot_section), "truncated snapshot: {}", path);
+
+			auto sections = reinterpret_cast<_snapshot_section*>(base + sizeof(_snapshot_header));
+			usize capacity = _cfg.max_entity_count;
+
+			// every array has to lie inside the file and the component has to have the size it was saved with,
+			// checked up front so a bad file is rejected before the current contents are dropped
+			auto check_section = [&](const _snapshot_section& sec, u64 type_hash, usize element_size, usize alignment)
+				{
+					auto fits = [&](u64 offset, usize bytes)
+						{
+							return offset <= file->size() && bytes <= file->size() - offset;
+						};
+
+					kw_verify_msg(sec.type_hash == type_hash, "snapshot section type mismatch in: {}", path);
+					kw_verify_msg(sec.element_size == element_size, "snapshot component with hash {} changed size, got: {} expected: {}", sec.type_hash, sec.element_size, element_size);
+					kw_verify_msg(sec.occupied <= capacity, "invalid snapshot: {}", path);
+					kw_verify_msg(sec.storage_offset % alignment == 0 && sec.indirect_map_offset % alignof(usize) == 0 && sec.reverse_indirect_map_offset % alignof(usize) == 0, "misaligned snapshot section in: {}", path);
+					kw_verify_msg(
+						fits(sec.storage_offset, capacity * element_size) &&
+						fits(sec.mask_offset, capacity * sizeof(bool)) &&
+						fits(sec.indirect_map_offset, capacity * sizeof(usize)) &&
+						fits(sec.reverse_indirect_map_offset, capacity * sizeof(usize)),
+						"truncated snapshot: {}", path
+					);
+				};
+
+			check_section(sections[0], meta::type_hash<entity_id>(), sizeof(entity_id), alignof(entity_id));
+			check_section(sections[1], meta::type_hash<entity_id>(), sizeof(entity_id), alignof(entity_id));
+
+			for (usize i = 2; i < header.section_count; i++)
+			{
+				auto& sec = sections[i];
+
+				bool listed = ((sec.type_hash == meta::type_hash<Components>()
+					? (check_section(sec, meta::type_hash<Components>(), sizeof(Components), alignof(Components)), true)
+					: false) || ...);
+
+				kw_verify_msg(listed, "snapshot component with hash {} is not listed in load_snapshot", sec.type_hash);
+			}
+
+			auto copy_section = [&](indirect_array_base& dst, const _snapshot_section& sec)
+				{
+					memcpy(dst._storage, base + sec.storage_offset, capacity * sec.element_size);
+					memcpy(dst._mask, base + sec.mask_offset, capacity * sizeof(bool));
+					memcpy(dst._indirect_map, base + sec.indirect_map_offset, capacity * sizeof(usize));
+					memcpy(dst._reverse_indirect_map, base + sec.reverse_indirect_map_offset, capacity * sizeof(usize));
+					dst._occupied = sec.occupied;
+				};
+
+			_storages.clear();
+			_storage_directory.clear();
+
+			copy_section(_entries.as_base(), sections[0]);
+			copy_section(_free_list.as_base(), sections[1]);
+			_id_counter = header.id_counter;
+
+			for (usize i = 2; i < header.section_count; i++)
+			{
+				auto& sec = sections[i];
+
+				component_storage::mapped_arrays arrays{
+					.storage = base + sec.storage_offset,
+					.mask = reinterpret_cast<bool*>(base + sec.mask_offset),
+					.indirect_map = reinterpret_cast<usize*>(base + sec.indirect_map_offset),
+					.reverse_indirect_map = reinterpret_cast<usize*>(base + sec.reverse_indirect_map_offset),
+					.capacity = capacity,
+					.occupied = sec.occupied
+				};
+
+				(void)((sec.type_hash == meta::type_hash<Components>()
+					? (_emplace_storage<Components>(arrays), true)
+					: false) || ...);
+			}
+
+			_snapshot_file = std::move(file);
+		}
+
+		constexpr static u64 _diff_magic = 0x313046444157414b; // "KAWADF01"
+
+		void diff(const registry& previous, dyn_array<u8>& out)
+		{
+			kw_assert(_cfg.max_entity_count == previous._cfg.max_entity_count);
+
+			byte_writer w(out);
+
+			w.write(_diff_magic);
+			w.write_varint(_id_counter);
+
+			usize created_at = w.reserve<u64>();
+			u64 created = 0;
+
+			for (auto e : _entries.as_base())
+			{
+				if (!previous._entries.contains(e))
+				{
+					w.write_varint(e);
+					created++;
+				}
+			}
+
+			w.write_at(created_at, created);
+
+			usize destroyed_at = w.reserve<u64>();
+			u64 destroyed = 0;
+
+			for (auto e : previous._entries.as_base())
+			{
+				if (!_entries.contains(e))
+				{
+					w.write_varint(e);
+					destroyed++;
+				}
+			}
+
+			w.write_at(destroyed_at, destroyed);
+
+			usize common = 0;
+			usize free_count = _free_list.occupied();
+			usize previous_free_count = previous._free_list.occupied();
+
+			while (common < free_count && common < previous_free_count && _free_list[common] == previous._free_list[common])
+			{
+				common++;
+			}
+
+			w.write_varint(common);
+			w.write_varint(free_count - common);
+
+			for (usize i = common; i < free_count; i++)
+			{
+				w.write_varint(_free_list[i]);
+			}
+
+			usize storage_count_at = w.reserve<u64>();
+			u64 storage_count = 0;
+
+			dyn_array<u8> previous_scratch;
+
+			auto write_storage = [&](component_storage* current, const component_storage* prev)
+				{
+					auto& info = current ? current->_vtable.type_info : prev->_vtable.type_info;
+
+					kw_verify_msg(info.trivially_copyable, "registry diff requires trivially copyable components, got: {}", info.name);
+
+					usize section_start = w.size();
+
+					previous_scratch.resize(info.size);
+
+					w.write(info.hash);
+					w.write_varint(info.size);
+
+					usize added_at = w.reserve<u64>();
+					u64 added = 0;
+					usize modified_at = w.reserve<u64>();
+					u64 modified = 0;
+					usize removed_at = w.reserve<u64>();
+					u64 removed = 0;
+
+					if (current)
+					{
+						for (auto e : *current)
+						{
+							if (!prev || !prev->contains(e))
+							{
+								w.write_varint(e);
+								w.write_bytes(current->_element_bytes(e, current->_soa_scratch.data()), info.size);
+								added++;
+							}
+						}
+
+						if (prev)
+						{
+							for (auto e : *current)
+							{
+								if (!prev->contains(e)) continue;
+
+								const u8* bytes = current->_element_bytes(e, current->_soa_scratch.data());
+
+								if (memcmp(bytes, prev->_element_bytes(e, previous_scratch.data()), info.size))
+								{
+									w.write_varint(e);
+									w.write_bytes(bytes, info.size);
+									modified++;
+								}
+							}
+						}
+					}
+
+					if (prev)
+					{
+						for (auto e : *prev)
+						{
+							if (!current || !current->contains(e))
+							{
+								w.write_varint(e);
+								removed++;
+							}
+						}
+					}
+
+					if (added || modified || removed)
+					{
+						w.write_at(added_at, added);
+						w.write_at(modified_at, modified);
+						w.write_at(removed_at, removed);
+						storage_count++;
+					}
+					else
+					{
+						out.resize(section_start);
+					}
+				};
+
+			for (usize id = 0; id < _storages.size(); id++)
+			{
+				if (_storages[id])
+				{
+					write_storage(_storages[id].get(), previous._try_get_storage(id));
+				}
+			}
+
+			for (usize id = 0; id < previous._storages.size(); id++)
+			{
+				if (previous._storages[id] && !_try_get_storage(id))
+				{
+					write_storage(nullptr, previous._storages[id].get());
+				}
+			}
+
+			w.write_at(storage_count_at, storage_count);
+		}
+
+		template<typename...Components>
+		void apply_diff(const dyn_array<u8>& data)
+		{
+			byte_reader r(data);
+
+			kw_verify_msg(r.read<u64>() == _diff_magic, "{}", "invalid registry diff");
+
+			u64 id_counter = r.read_varint();
+			kw_verify_msg(id_counter <= _cfg.max_entity_count, "registry diff id counter out of range: {}", id_counter);
+
+			auto read_id = [&]()
+				{
+					u64 e = r.read_varint();
+					kw_verify_msg(e < _cfg.max_entity_count, "registry diff entity out of range: {}", e);
+					return entity_id(e);
+				};
+
+			u64 created = r.read<u64>();
+			for (u64 i = 0; i < created; i++)
+			{
+				_entries.emplace(read_id());
+			}
+
+			u64 destroyed = r.read<u64>();
+			for (u64 i = 0; i < destroyed; i++)
+			{
+				entity_id e = read_id();
+
+				for (auto& s : _storages)
+				{
+					if (s)
+					{
+						s->erase(e);
+					}
+				}
+
+				_entries.erase(e);
+			}
+
+			u64 common = r.read_varint();
+			u64 pushed = r.read_varint();
+
+			kw_verify_msg(common <= _free_list.occupied() && common + pushed <= _cfg.max_entity_count, "{}", "invalid registry diff free list");
+
+			while (_free_list.occupied() > common)
+			{
+				_free_list.erase(_free_list.occupied() - 1);
+			}
+
+			for (u64 i = 0; i < pushed; i++)
+			{
+				_free_list.emplace(_free_list.occupied(), read_id());
+			}
+
+			_id_counter = id_counter;
+
+			u64 storage_count = r.read<u64>();
+
+			for (u64 i = 0; i < storage_count; i++)
+			{
+				u64 hash = r.read<u64>();
+				u64 size = r.read_varint();
+				u64 added = r.read<u64>();
+				u64 modified = r.read<u64>();
+				u64 removed = r.read<u64>();
+
+				component_storage* s = _find_storage(hash);
+
+				if (!s && (added || modified))
+				{
+					((hash == meta::type_hash<Components>() ? (s = &_lazy_get_storage<Components>(), true) : false) || ...);
+				}
+
+				kw_verify_msg(s || !(added || modified), "registry diff component with hash {} has no storage and is not listed in apply_diff", hash);
+				kw_verify_msg(!s || (s->_vtable.type_info.size == size && s->_vtable.type_info.trivially_copyable), "registry diff layout mismatch for {}", s->_vtable.type_info.name);
+
+				for (u64 j = 0; j < added + modified; j++)
+				{
+					entity_id e = read_id();
+					s->_emplace_bytes(e, r.read_bytes(size));
+				}
+
+				for (u64 j = 0; j < removed; j++)
+				{
+					entity_id e = read_id();
+
+					if (s)
+					{
+						s->erase(e);
+					}
+				}
+			}
+		}
+
 		template<typename T>
-		component_storage&_lazy_get_storage() noexcept
+		component_storage& _lazy_get_storage() noexcept
 		{
-			constexpr auto hash = meta::type_hash<T>();
+			usize id = component_type_id<T>();
 
-			if (auto v = _storages.try_get(hash))
+			if (id < _storages.size() && _storages[id]) [[likely]]
 			{
-				return *v;
+				return *_storages[id];
 			}
-			else
+
+			return _emplace_storage<T>(_cfg.max_entity_count, _cfg.resource);
+		}
+
+		template<typename T>
+		component_storage& _get_storage() noexcept
+		{
+			usize id = component_type_id<T>();
+
+			kw_verify_msg(id < _storages.size() && _storages[id], "storage for {} does not exist, prepare it before concurrent use", meta::type_name<T>());
+
+			return *_storages[id];
+		}
+
+		template<typename...Args>
+		static _storage_ptr _make_storage(memory_resource* resource, Args&&...args)
+		{
+			void* memory = resource->allocate(sizeof(component_storage), alignof(component_storage));
+			return _storage_ptr(new (memory) component_storage(std::forward<Args>(args)...), { resource });
+		}
+
+		template<typename T, typename...Args>
+		component_storage& _emplace_storage(Args&&...args)
+		{
+			usize id = component_type_id<T>();
+
+			if (id >= _storages.size())
+			{
+				_storages.resize(id + 1);
+			}
+
+			_storages[id] = _make_storage(_cfg.resource, meta::construct_tag<T>{}, std::forward<Args>(args)...);
+			_storage_directory.insert(meta::type_hash<T>(), id);
+
+			return *_storages[id];
+		}
+
+		component_storage& _emplace_storage_like(usize id, const component_storage& other)
+		{
+			if (id >= _storages.size())
+			{
+				_storages.resize(id + 1);
+			}
+
+			_storages[id] = _make_storage(_cfg.resource, other._vtable, other._soa, _cfg.max_entity_count, _cfg.resource);
+			_storage_directory.insert(other._vtable.type_info.hash, id);
+
+			return *_storages[id];
+		}
+
+		component_storage* _try_get_storage(usize id) noexcept
+		{
+			return id < _storages.size() ? _storages[id].get() : nullptr;
+		}
+
+		const component_storage* _try_get_storage(usize id) const noexcept
+		{
+			return id < _storages.size() ? _storages[id].get() : nullptr;
+		}
+
+		template<typename T>
+		const component_storage* _try_get_storage() const noexcept
+		{
+			usize id = component_type_id<T>();
+			return id < _storages.size() ? _storages[id].get() : nullptr;
+		}
+
+		component_storage* _find_storage(u64 hash) noexcept
+		{
+			if (auto id = _storage_directory.try_get(hash))
 			{
-				return _storages.insert(hash, meta::construct_tag<T>{}, _cfg.max_entity_count);
+				return _storages[*id].get();
 			}
-		}		
 
-		hash_map<component_storage> _storages;
+			return nullptr;
+		}
+
+		shared<mapped_file> _snapshot_file;
+		_storage_array _storages;
+		dyn_array<unique<event_channel_base>> _event_channels;
+		hash_map<usize> _storage_directory;
 		indirect_array<entity_id> _free_list;
 		indirect_array<entity_id> _entries;
 		entity_id _id_counter = 0;
@@ -0,0 +1,34 @@
+#ifndef KAWA_ENTITY_ID
+#define KAWA_ENTITY_ID
+
+#include "core_types.h"
+
+namespace kawa
+{
+	struct entity_id
+	{
+		constexpr static u64 invalid = std::numeric_limits<u64>::max();
+
+		entity_id() noexcept : val(invalid) {}
+		entity_id(u64 id) noexcept : val(id) {}
+
+		bool is_valid() const noexcept
+		{
+			return val != invalid;
+		}
+
+		operator u64& () noexcept
+		{
+			return val;
+		}
+
+		operator const u64& () const noexcept
+		{
+			return val;
+		}
+
+		u64 val;
+	};
+}
+
+#endif // !KAWA_ENTITY_ID
@@ -0,0 +1,151 @@
+#ifndef KAWA_EVENT_CHANNEL
+#define KAWA_EVENT_CHANNEL
+
+#include <mutex>
+
+#include "core_types.h"
+
+#ifndef kw_max_event_writers
+#define kw_max_event_writers 64
+#endif
+
+namespace kawa
+{
+	struct _event_writer_slots
+	{
+		std::mutex mutex;
+		dyn_array<usize> released;
+		usize next = 0;
+	};
+
+	inline _event_writer_slots _event_writer_pool;
+
+	// slots go back to the pool when their thread exits so short lived threads don't use them up,
+	// events the thread left in its buffers are still picked up by the next swap
+	struct _event_writer_slot
+	{
+		_event_writer_slot() noexcept
+		{
+			std::lock_guard lock(_event_writer_pool.mutex);
+
+			if (_event_writer_pool.released.empty())
+			{
+				index = _event_writer_pool.next++;
+			}
+			else
+			{
+				index = _event_writer_pool.released.back();
+				_event_writer_pool.released.pop_back();
+			}
+		}
+
+		~_event_writer_slot()
+		{
+			std::lock_guard lock(_event_writer_pool.mutex);
+			_event_writer_pool.released.push_back(index);
+		}
+
+		usize index;
+	};
+
+	// every thread currently able to send events owns a writer slot, shared by all channels
+	inline usize _event_writer_index() noexcept
+	{
+		thread_local const _event_writer_slot slot;
+		return slot.index;
+	}
+
+	struct event_channel_base
+	{
+		virtual ~event_channel_base() = default;
+
+		virtual void swap() noexcept = 0;
+		virtual void clear() noexcept = 0;
+	};
+
+	// events sent during a frame become readable after the next swap and stay readable for that whole
+	// frame, send is lock free and can be called from any thread (query_par workers included) since each
+	// thread appends to its own buffer, swap and clear must not run concurrently with send or read
+	template<typename T>
+	struct event_channel : event_channel_base
+	{
+		constexpr static usize max_writers = kw_max_event_writers;
+
+		struct alignas(64) writer
+		{
+			dyn_array<T> pending;
+			dyn_array<T> ready;
+		};
+
+		event_channel() noexcept
+			: _writers(new writer[max_writers])
+		{
+		}
+
+		template<typename...Args>
+		T& send(Args&&...args)
+		{
+			usize index = _event_writer_index();
+
+			kw_verify_msg(index < max_writers, "too many live threads sending events, max is {}, raise kw_max_event_writers", max_writers);
+
+			return _writers[index].pending.emplace_back(std::forward<Args>(args)...);
+		}
+
+		void swap() noexcept override
+		{
+			for (usize i = 0; i < max_writers; i++)
+			{
+				writer& w = _writers[i];
+
+				if (w.pending.empty() && w.ready.empty()) continue;
+
+				w.ready.swap(w.pending);
+				w.pending.clear();
+			}
+		}
+
+		void clear() noexcept override
+		{
+			for (usize i = 0; i < max_writers; i++)
+			{
+				_writers[i].pending.clear();
+				_writers[i].ready.clear();
+			}
+		}
+
+		// visits the events made readable by the last swap, grouped by the thread that sent them
+		template<typename Fn>
+		void read(Fn&& func) const
+		{
+			for (usize i = 0; i < max_writers; i++)
+			{
+				for (const T& e : _writers[i].ready)
+				{
+					func(e);
+				}
+			}
+		}
+
+		usize size() const noexcept
+		{
+			usize out = 0;
+
+			for (usize i = 0; i < max_writers; i++)
+			{
+				out += _writers[i].ready.size();
+			}
+
+			return out;
+		}
+
+		bool empty() const noexcept
+		{
+			return !size();
+		}
+
+		unique<writer[]> _writers;
+	};
+}
+
+#endif // !KAWA_EVENT_CHANNEL
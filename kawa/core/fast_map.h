@@ -1,230 +1,442 @@
 #ifndef KAWA_FAST_MAP
 #define KAWA_FAST_MAP
 
+#include <bit>
+#include <cstring>
+
 #include "core_types.h"
-#include "indirect_array.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KAWA_FAST_MAP_SSE2
+#endif
 
 namespace kawa
 {
-
+	// open addressing map keyed by u64 hashes, control bytes are probed a group at a time,
+	// probing is linear so erase can shift the cluster back instead of leaving tombstones
 	template<typename T>
 	struct hash_map
 	{
 		struct config
 		{
 			usize capacity = 128;
-			usize collision_depth = 8;
+			memory_resource* resource = default_memory_resource();
 		};
 
-		hash_map(const config& cfg)
-			: _cfg(cfg)
-			, values(cfg.capacity* cfg.collision_depth)
-			, keys(cfg.capacity * cfg.collision_depth)
+		struct slot
 		{
-			_capacity = _cfg.capacity * _cfg.collision_depth;
-		}
+			u64 key;
+			T value;
+		};
+
+		constexpr static u8 _empty = 0x80;
+		constexpr static usize _group_width = 16;
+		constexpr static usize _npos = std::numeric_limits<usize>::max();
 
-		hash_map(const hash_map&) = default;
-		hash_map(hash_map&&) = default;
+		struct iterator
+		{
+			iterator& operator++() noexcept
+			{
+				current++;
+				_skip_empty();
+				return *this;
+			}
 
-		hash_map& operator=(const hash_map&) = default;
-		hash_map& operator=(hash_map&&) = default;
+			slot& operator*() const noexcept
+			{
+				return self->_slots[current];
+			}
 
-		void clear() noexcept
+			slot* operator->() const noexcept
+			{
+				return self->_slots + current;
+			}
+
+			bool operator==(const iterator& other) const noexcept
+			{
+				return current == other.current;
+			}
+
+			void _skip_empty() noexcept
+			{
+				while (current < self->_capacity && self->_ctrl[current] == _empty)
+				{
+					current++;
+				}
+			}
+
+			const hash_map* self;
+			usize current;
+		};
+
+		hash_map(const config& cfg = {})
 		{
-			keys.refresh(_capacity);
-			values.refresh(_capacity);
+			_resource = cfg.resource;
+			_allocate(_capacity_for(cfg.capacity));
 		}
 
-		template<typename...Args>
-		T& insert(u64 hash_key, Args&&...args)
+		hash_map(const hash_map& other)
+		{
+			*this = other;
+		}
+
+		hash_map(hash_map&& other) noexcept
 		{
-			usize index = hash_key % _capacity;
+			*this = std::move(other);
+		}
 
-			for (usize i = 0; i < _cfg.collision_depth; i++)
+		hash_map& operator=(const hash_map& other)
+		{
+			if (this != &other)
 			{
-				if (!keys.contains(index))
-				{
-					keys.emplace(index, hash_key);
-					return values.emplace(index, std::forward<Args>(args)...);
-				}
-				else
+				_release();
+
+				_resource = other._resource;
+				_allocate(other._capacity);
+
+				memcpy(_ctrl, other._ctrl, _capacity + _group_width);
+
+				for (usize i = 0; i < _capacity; i++)
 				{
-					if (keys[index] == hash_key)
-					{
-						return values.emplace(index, std::forward<Args>(args)...);
-					}
-					else
+					if (_ctrl[i] != _empty)
 					{
-						index++;
+						new (_slots + i) slot(other._slots[i]);
 					}
 				}
+
+				_size = other._size;
 			}
 
-			kw_assert_msg(false, "hash_map collision depth exceeded");
+			return *this;
 		}
 
-		bool contains(u64 hash_key)
+		hash_map& operator=(hash_map&& other) noexcept
 		{
-			usize index = hash_key % _capacity;
+			if (this != &other)
+			{
+				_release();
+
+				_slots = other._slots;
+				_ctrl = other._ctrl;
+				_capacity = other._capacity;
+				_size = other._size;
+				_resource = other._resource;
 
-			for (usize i = 0; i < _cfg.collision_depth; i++)
+				other._slots = nullptr;
+				other._ctrl = nullptr;
+				other._capacity = 0;
+				other._size = 0;
+			}
+
+			return *this;
+		}
+
+		~hash_map() noexcept
+		{
+			_release();
+		}
+
+		void clear() noexcept
+		{
+			if (!_ctrl) return;
+
+			for (usize i = 0; i < _capacity; i++)
 			{
-				if (!keys.contains(index))
-				{
-					return false;
-				}
-				else
+				if (_ctrl[i] != _empty)
 				{
-					if (keys[index] == hash_key)
-					{
-						return true;
-					}
-					else
-					{
-						index++;
-					}
+					_slots[i].~slot();
 				}
 			}
+
+			memset(_ctrl, _empty, _capacity + _group_width);
+			_size = 0;
 		}
 
-		void erase(u64 hash_key)
+		template<typename...Args>
+		T& insert(u64 hash_key, Args&&...args)
 		{
-			auto index = hash_key % _capacity;
-			usize curr_collison = 0;
+			usize index = _find(hash_key);
 
-			for (usize i = 0; i < _cfg.collision_depth; i++)
+			if (index != _npos)
 			{
-				if (!keys.contains(index))
-				{
-					return;
-				}
-				else
-				{
-					if (keys[index] == hash_key)
-					{
-						values.erase(index);
-						keys.erase(index);
-						return;
-					}
-					else
-					{
-						index++;
-					}
-				}
+				_slots[index].value.~T();
+				return *new (&_slots[index].value) T(std::forward<Args>(args)...);
+			}
+
+			if ((_size + 1) * 8 > _capacity * 7)
+			{
+				_rehash(_capacity ? _capacity * 2 : _group_width);
 			}
+
+			u64 h = _mix(hash_key);
+			index = _find_empty(h);
+
+			new (_slots + index) slot{ hash_key, T(std::forward<Args>(args)...) };
+			_set_ctrl(index, _h2(h));
+			_size++;
+
+			return _slots[index].value;
 		}
 
-		T& get(u64 hash_key) noexcept
+		bool contains(u64 hash_key) const noexcept
+		{
+			return _find(hash_key) != _npos;
+		}
+
+		void erase(u64 hash_key) noexcept
 		{
-			usize index = hash_key % _capacity;
+			usize hole = _find(hash_key);
+
+			if (hole == _npos) return;
+
+			_slots[hole].~slot();
+			_size--;
 
-			for (usize i = 0; i < _cfg.collision_depth; i++)
+			usize mask = _capacity - 1;
+			usize next = hole;
+
+			while (true)
 			{
-				if (!keys.contains(index))
-				{
-					kw_assert(false);
-				}
-				else
+				next = (next + 1) & mask;
+
+				if (_ctrl[next] == _empty) break;
+
+				usize home = _h1(_mix(_slots[next].key)) & mask;
+
+				bool home_in_range = (hole <= next)
+					? (hole < home && home <= next)
+					: (hole < home || home <= next);
+
+				if (!home_in_range)
 				{
-					if (keys[index] == hash_key)
-					{
-						return values.get(index);
-					}
-					else
-					{
-						index++;
-					}
+					new (_slots + hole) slot(std::move(_slots[next]));
+					_slots[next].~slot();
+
+					_set_ctrl(hole, _ctrl[next]);
+					hole = next;
 				}
 			}
 
-			kw_assert(false);
+			_set_ctrl(hole, _empty);
+		}
+
+		T& get(u64 hash_key) noexcept
+		{
+			usize index = _find(hash_key);
+			kw_assert(index != _npos);
+			return _slots[index].value;
 		}
 
 		const T& get(u64 hash_key) const noexcept
 		{
-			usize index = hash_key % _capacity;
+			usize index = _find(hash_key);
+			kw_assert(index != _npos);
+			return _slots[index].value;
+		}
+
+		T* try_get(u64 hash_key) noexcept
+		{
+			usize index = _find(hash_key);
+			return index != _npos ? &_slots[index].value : nullptr;
+		}
+
+		const T* try_get(u64 hash_key) const noexcept
+		{
+			usize index = _find(hash_key);
+			return index != _npos ? &_slots[index].value : nullptr;
+		}
+
+		usize size() const noexcept
+		{
+			return _size;
+		}
+
+		usize capacity() const noexcept
+		{
+			return _capacity;
+		}
+
+		bool empty() const noexcept
+		{
+			return !_size;
+		}
+
+		usize memory_usage() const noexcept
+		{
+			return _capacity ? _capacity * sizeof(slot) + _capacity + _group_width : 0;
+		}
 
-			for (usize i = 0; i < _cfg.collision_depth; i++)
+		iterator begin() const noexcept
+		{
+			iterator it{ this, 0 };
+			it._skip_empty();
+			return it;
+		}
+
+		iterator end() const noexcept
+		{
+			return { this, _capacity };
+		}
+
+		static inline u64 _mix(u64 key) noexcept
+		{
+			u64 h = key * 0x9e3779b97f4a7c15ull;
+			return h ^ (h >> 29);
+		}
+
+		static inline usize _h1(u64 h) noexcept
+		{
+			return static_cast<usize>(h >> 7);
+		}
+
+		static inline u8 _h2(u64 h) noexcept
+		{
+			return static_cast<u8>(h & 0x7f);
+		}
+
+		static inline u32 _match(const u8* group, u8 value) noexcept
+		{
+#ifdef KAWA_FAST_MAP_SSE2
+			__m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+			return static_cast<u32>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(static_cast<char>(value)))));
+#else
+			u32 out = 0;
+			for (usize i = 0; i < _group_width; i++)
 			{
-				if (!keys.contains(index))
-				{
-					kw_assert(false);
-				}
-				else
-				{
-					if (keys[index] == hash_key)
-					{
-						return values.get(index);
-					}
-					else
-					{
-						index++;
-					}
-				}
+				out |= static_cast<u32>(group[i] == value) << i;
 			}
+			return out;
+#endif
+		}
 
-			kw_assert(false);
+		static inline u32 _match_empty(const u8* group) noexcept
+		{
+#ifdef KAWA_FAST_MAP_SSE2
+			return static_cast<u32>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+			return _match(group, _empty);
+#endif
 		}
 
-		T* try_get(u64 hash_key) noexcept
+		usize _find(u64 hash_key) const noexcept
 		{
-			usize index = hash_key % _capacity;
+			u64 h = _mix(hash_key);
+			u8 h2 = _h2(h);
+			usize mask = _capacity - 1;
+			usize pos = _h1(h) & mask;
 
-			for (usize i = 0; i < _cfg.collision_depth; i++)
+			for (usize probed = 0; probed < _capacity; probed += _group_width)
 			{
-				if (!keys.contains(index))
-				{
-					return nullptr;
-				}
-				else
+				const u8* group = _ctrl + pos;
+
+				for (u32 m = _match(group, h2); m; m &= m - 1)
 				{
-					if (keys[index] == hash_key)
-					{
-						return &values.get(index);
-					}
-					else
+					usize index = (pos + std::countr_zero(m)) & mask;
+
+					if (_slots[index].key == hash_key)
 					{
-						index++;
+						return index;
 					}
 				}
+
+				if (_match_empty(group))
+				{
+					return _npos;
+				}
+
+				pos = (pos + _group_width) & mask;
 			}
 
-			return nullptr;
+			return _npos;
 		}
 
-		const T* try_get(u64 hash_key) const noexcept
+		usize _find_empty(u64 h) const noexcept
 		{
-			usize index = hash_key % _capacity;
+			usize mask = _capacity - 1;
+			usize pos = _h1(h) & mask;
 
-			for (usize i = 0; i < _cfg.collision_depth; i++)
+			while (true)
 			{
-				if (!keys.contains(index))
+				if (u32 m = _match_empty(_ctrl + pos))
 				{
-					return nullptr;
+					return (pos + std::countr_zero(m)) & mask;
 				}
-				else
+
+				pos = (pos + _group_width) & mask;
+			}
+		}
+
+		void _set_ctrl(usize index, u8 value) noexcept
+		{
+			_ctrl[index] = value;
+
+			if (index < _group_width)
+			{
+				_ctrl[_capacity + index] = value;
+			}
+		}
+
+		void _rehash(usize new_capacity)
+		{
+			slot* old_slots = _slots;
+			u8* old_ctrl = _ctrl;
+			usize old_capacity = _capacity;
+
+			_allocate(new_capacity);
+
+			for (usize i = 0; i < old_capacity; i++)
+			{
+				if (old_ctrl[i] != _empty)
 				{
-					if (keys[index] == hash_key)
-					{
-						return &values.get(index);
-					}
-					else
-					{
-						index++;
-					}
+					u64 h = _mix(old_slots[i].key);
+					usize index = _find_empty(h);
+
+					new (_slots + index) slot(std::move(old_slots[i]));
+					old_slots[i].~slot();
+
+					_set_ctrl(index, _h2(h));
 				}
 			}
 
-			return nullptr;
+			_resource->deallocate(old_slots, old_capacity * sizeof(slot), alignof(slot));
+			_resource->deallocate(old_ctrl, old_capacity + _group_width, _group_width);
 		}
 
-		indirect_array<T> values;
-		indirect_array<u64> keys;
+		void _allocate(usize capacity)
+		{
+			_capacity = capacity;
+			_slots = (slot*)_resource->allocate(_capacity * sizeof(slot), alignof(slot));
+			_ctrl = (u8*)_resource->allocate(_capacity + _group_width, _group_width);
+
+			memset(_ctrl, _empty, _capacity + _group_width);
+		}
+
+		void _release() noexcept
+		{
+			if (_slots)
+			{
+				clear();
+
+				_resource->deallocate(_slots, _capacity * sizeof(slot), alignof(slot));
+				_resource->deallocate(_ctrl, _capacity + _group_width, _group_width);
+
+				_slots = nullptr;
+				_ctrl = nullptr;
+				_capacity = 0;
+			}
+		}
+
+		static usize _capacity_for(usize count) noexcept
+		{
+			return std::bit_ceil(std::max<usize>(_group_width, count + count / 7 + 1));
+		}
 
-	private:
+		slot* _slots = nullptr;
+		u8* _ctrl = nullptr;
 		usize _capacity = 0;
-		config _cfg;
+		usize _size = 0;
+		memory_resource* _resource = default_memory_resource();
 	};
 
 }
@@ -0,0 +1,124 @@
+#ifndef KAWA_HUGE_PAGE_RESOURCE
+#define KAWA_HUGE_PAGE_RESOURCE
+
+#include "core_types.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0
+#endif
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0
+#endif
+#endif
+
+namespace kawa
+{
+	// requests of at least huge_page_size are mapped straight from the os and backed by huge pages
+	// where the system allows it (hugetlb pages, then transparent huge pages on linux, large pages on
+	// windows when the process holds SeLockMemoryPrivilege), smaller ones go to the upstream resource
+	struct huge_page_resource : memory_resource
+	{
+		constexpr static usize huge_page_size = 2 * 1024 * 1024;
+
+		huge_page_resource(bool prefault = false, memory_resource* upstream = default_memory_resource()) noexcept
+			: _upstream(upstream)
+			, _prefault(prefault)
+		{
+		}
+
+		static usize _round_up(usize bytes) noexcept
+		{
+			return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+		}
+
+		void* do_allocate(usize bytes, usize alignment) override
+		{
+			if (bytes < huge_page_size)
+			{
+				return _upstream->allocate(bytes, alignment);
+			}
+
+			kw_assert(alignment <= huge_page_size);
+
+			usize size = _round_up(bytes);
+
+#ifdef _WIN32
+			void* out = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+			if (!out)
+			{
+				out = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			}
+
+			if (!out) throw std::bad_alloc();
+#else
+			int populate = _prefault ? MAP_POPULATE : 0;
+
+			void* out = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate, -1, 0);
+
+			if (out == MAP_FAILED)
+			{
+				// over map so the region can be trimmed to a huge page boundary, otherwise khugepaged can't collapse it
+				u8* raw = (u8*)mmap(nullptr, size + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+				if (raw == MAP_FAILED) throw std::bad_alloc();
+
+				u8* aligned = (u8*)_round_up((usize)raw);
+
+				if (aligned != raw) munmap(raw, aligned - raw);
+				if (usize tail = (raw + size + huge_page_size) - (aligned + size)) munmap(aligned + size, tail);
+
+#ifdef MADV_HUGEPAGE
+				madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+
+				if (_prefault)
+				{
+					for (usize i = 0; i < size; i += huge_page_size)
+					{
+						aligned[i] = 0;
+					}
+				}
+
+				out = aligned;
+			}
+#endif
+			return out;
+		}
+
+		void do_deallocate(void* ptr, usize bytes, usize alignment) override
+		{
+			if (bytes < huge_page_size)
+			{
+				_upstream->deallocate(ptr, bytes, alignment);
+				return;
+			}
+
+#ifdef _WIN32
+			VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+			munmap(ptr, _round_up(bytes));
+#endif
+		}
+
+		bool do_is_equal(const memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+
+		memory_resource* _upstream;
+		bool _prefault;
+	};
+}
+
+#endif // !KAWA_HUGE_PAGE_RESOURCE
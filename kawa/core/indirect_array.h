@@ -1,6 +1,8 @@
 #ifndef KAWA_INDIRECT_ARRAY
 #define KAWA_INDIRECT_ARRAY
 
+#include <cstring>
+
 #include "core_types.h"
 #include "any.h"
 
@@ -13,6 +15,52 @@ namespace kawa
 			return _mask[index];
 		}
 
+		// safe to call from several threads at once as long as each thread claims its own indices
+		bool _claim_concurrent(usize index) noexcept
+		{
+			if (_mask[index]) return false;
+
+			usize indirect_index = std::atomic_ref<usize>(_occupied).fetch_add(1, std::memory_order_relaxed);
+
+			_reverse_indirect_map[index] = indirect_index;
+			_indirect_map[indirect_index] = index;
+			_mask[index] = true;
+
+			return true;
+		}
+
+		void _allocate_arrays(usize capacity, usize element_size, usize alignment)
+		{
+			_capacity = capacity;
+
+			_storage = (u8*)_resource->allocate(capacity * element_size, alignment);
+			_mask = (bool*)_resource->allocate(capacity * sizeof(bool), alignof(bool));
+			_indirect_map = (usize*)_resource->allocate(capacity * sizeof(usize), alignof(usize));
+			_reverse_indirect_map = (usize*)_resource->allocate(capacity * sizeof(usize), alignof(usize));
+
+			memset(_mask, 0, capacity * sizeof(bool));
+			memset(_indirect_map, 0, capacity * sizeof(usize));
+			memset(_reverse_indirect_map, 0, capacity * sizeof(usize));
+		}
+
+		void _release_arrays(usize element_size, usize alignment) noexcept
+		{
+			_resource->deallocate(_storage, _capacity * element_size, alignment);
+			_resource->deallocate(_mask, _capacity * sizeof(bool), alignof(bool));
+			_resource->deallocate(_indirect_map, _capacity * sizeof(usize), alignof(usize));
+			_resource->deallocate(_reverse_indirect_map, _capacity * sizeof(usize), alignof(usize));
+
+			_storage = nullptr;
+			_mask = nullptr;
+			_indirect_map = nullptr;
+			_reverse_indirect_map = nullptr;
+		}
+
+		usize _metadata_bytes() const noexcept
+		{
+			return _capacity * (sizeof(bool) + sizeof(usize) * 2);
+		}
+
 		usize* begin() const noexcept
 		{
 			return _indirect_map;
@@ -30,6 +78,8 @@ namespace kawa
 		usize* _indirect_map = nullptr;
 		usize* _reverse_indirect_map = nullptr;
 		usize _occupied = 0;
+
+		memory_resource* _resource = default_memory_resource();
 	};
 
 
@@ -62,8 +112,9 @@ namespace kawa
 			usize current = 0;
 		};
 
-		indirect_array(usize capacity) noexcept
+		indirect_array(usize capacity, memory_resource* resource = default_memory_resource()) noexcept
 		{
+			_resource = resource;
 			refresh(capacity);
 		};
 
@@ -73,14 +124,10 @@ namespace kawa
 			{
 				release();			
 
-				_capacity = other._capacity;
+				_resource = other._resource;
+				_allocate_arrays(other._capacity, sizeof(T), alignof(T));
 				_occupied = other._occupied;
 
-				_storage = (u8*)::operator new(_capacity * sizeof(T), std::align_val_t{ alignof(T) });
-				_mask = new bool[_capacity] {};
-				_indirect_map = new usize[_capacity]{};
-				_reverse_indirect_map = new usize[_capacity]{};
-
 				memcpy(_mask, other._mask, _capacity * sizeof(bool));
 				memcpy(_indirect_map, other._indirect_map, _capacity * sizeof(usize));
 				memcpy(_reverse_indirect_map, other._reverse_indirect_map, _capacity * sizeof(usize));
@@ -112,6 +159,7 @@ namespace kawa
 				_indirect_map = other._indirect_map;
 				_reverse_indirect_map = other._reverse_indirect_map;
 				_occupied = other._occupied;
+				_resource = other._resource;
 
 				other._storage = nullptr;
 				other._occupied = 0;
@@ -143,28 +191,30 @@ namespace kawa
 					reinterpret_cast<T*>(_storage)[_indirect_map[i]].~T();
 				}
 
-				::operator delete(_storage, _capacity * sizeof(T), std::align_val_t{ alignof(T) });
+				_release_arrays(sizeof(T), alignof(T));
+				_occupied = 0;
+			}
 
-				_storage = nullptr;
+		}
 
-				delete[] _mask;
-				delete[] _indirect_map;
-				delete[] _reverse_indirect_map;
-				_occupied = 0;
+		void clear() noexcept
+		{
+			for (usize i = 0; i < _occupied; i++)
+			{
+				usize idx = _indirect_map[i];
+
+				reinterpret_cast<T*>(_storage)[idx].~T();
+				_mask[idx] = false;
 			}
 
+			_occupied = 0;
 		}
 
 		void refresh(usize capacity)
 		{
 			release();
 
-			_storage = (u8*)::operator new(capacity * sizeof(T), std::align_val_t{ alignof(T) });
-			_mask = new bool[capacity]{};
-			_indirect_map = new usize[capacity]{};
-			_reverse_indirect_map = new usize[capacity]{};
-
-			_capacity = capacity;
+			_allocate_arrays(capacity, sizeof(T), alignof(T));
 		}
 
 		template<typename...Args>
@@ -195,6 +245,23 @@ namespace kawa
 			return *out;
 		}
 
+		template<typename...Args>
+		T& emplace_concurrent(usize index, Args&&...args) noexcept
+		{
+			kw_assert(index < _capacity);
+
+			T* out = reinterpret_cast<T*>(_storage) + index;
+
+			if (!_claim_concurrent(index))
+			{
+				out->~T();
+			}
+
+			new (out) T(std::forward<Args>(args)...);
+
+			return *out;
+		}
+
 		void erase(usize index) noexcept
 		{
 			kw_assert(index < _capacity);
@@ -255,16 +322,26 @@ namespace kawa
 			return nullptr;
 		}
 
-		usize occupied() noexcept
+		usize occupied() const noexcept
 		{
 			return _occupied;
 		}
 
+		usize memory_usage() const noexcept
+		{
+			return _capacity * sizeof(T) + _metadata_bytes();
+		}
+
 		indirect_array_base& as_base() noexcept
 		{
 			return *(indirect_array_base*)this;
 		}
 
+		const indirect_array_base& as_base() const noexcept
+		{
+			return *(const indirect_array_base*)this;
+		}
+
 		bool empty() noexcept
 		{
 			return !_occupied;
@@ -17,6 +17,14 @@
 #define kw_assume(x) ((void)0)
 #endif
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#define kw_prefetch(addr) _mm_prefetch(reinterpret_cast<const char*>(addr), _MM_HINT_T0)
+#elif __GNUC__ || __clang__
+#define kw_prefetch(addr) __builtin_prefetch((addr))
+#else
+#define kw_prefetch(addr) ((void)0)
+#endif
 
 #ifdef _MSC_VER
 #include <intrin.h>
@@ -27,6 +35,16 @@
 #define kw_debugbreak() std::terminate() 
 #endif
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define kw_cpu_relax() _mm_pause()
+#elif (__GNUC__ || __clang__) && (defined(__x86_64__) || defined(__i386__))
+#define kw_cpu_relax() __builtin_ia32_pause()
+#elif (__GNUC__ || __clang__) && defined(__aarch64__)
+#define kw_cpu_relax() asm volatile("yield")
+#else
+#define kw_cpu_relax() ((void)0)
+#endif
+
 
 #define kw_stringify(x) #x
 #define kw_expand_stringify(x) kw_stringify(x)
@@ -121,7 +139,7 @@ struct name \
 #define kw_log_handle stdout
 #endif
 
-#define kw_put(dest, fmt, ...)  std::fputs(std::format(fmt, __VA_ARGS__).c_str(), dest)
+#define kw_put(dest, fmt, ...)  std::fputs(std::format(fmt __VA_OPT__(,) __VA_ARGS__).c_str(), dest)
 
 #define kw_print(fmt, ...) kw_put(kw_log_handle, fmt, __VA_ARGS__)
 #define kw_println(fmt, ...) kw_put(kw_log_handle, fmt, __VA_ARGS__), kw_put(kw_log_handle, "{}", "\n")
@@ -0,0 +1,162 @@
+#ifndef KAWA_MAPPED_FILE
+#define KAWA_MAPPED_FILE
+
+#include "core_types.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace kawa
+{
+	// private (copy-on-write) mapping of a whole file, pages are faulted in lazily
+	// and copied by the os only when written to, the file itself is never modified
+	struct mapped_file
+	{
+		mapped_file() noexcept = default;
+
+		mapped_file(const string& path) noexcept
+		{
+			open(path);
+		}
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		mapped_file(mapped_file&& other) noexcept
+		{
+			*this = std::move(other);
+		}
+
+		mapped_file& operator=(mapped_file&& other) noexcept
+		{
+			if (this != &other)
+			{
+				close();
+
+				_data = other._data;
+				_size = other._size;
+#ifdef _WIN32
+				_file = other._file;
+				_mapping = other._mapping;
+
+				other._file = INVALID_HANDLE_VALUE;
+				other._mapping = nullptr;
+#endif
+				other._data = nullptr;
+				other._size = 0;
+			}
+
+			return *this;
+		}
+
+		~mapped_file() noexcept
+		{
+			close();
+		}
+
+		bool open(const string& path) noexcept
+		{
+			close();
+
+#ifdef _WIN32
+			_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (_file == INVALID_HANDLE_VALUE) return false;
+
+			LARGE_INTEGER file_size{};
+			if (!GetFileSizeEx(_file, &file_size) || file_size.QuadPart == 0)
+			{
+				close();
+				return false;
+			}
+
+			_mapping = CreateFileMappingA(_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+			if (!_mapping)
+			{
+				close();
+				return false;
+			}
+
+			_data = (u8*)MapViewOfFile(_mapping, FILE_MAP_COPY, 0, 0, 0);
+			if (!_data)
+			{
+				close();
+				return false;
+			}
+
+			_size = (usize)file_size.QuadPart;
+#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) return false;
+
+			struct stat st {};
+			if (fstat(fd, &st) != 0 || st.st_size == 0)
+			{
+				::close(fd);
+				return false;
+			}
+
+			void* ptr = mmap(nullptr, (usize)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+			::close(fd);
+
+			if (ptr == MAP_FAILED) return false;
+
+			_data = (u8*)ptr;
+			_size = (usize)st.st_size;
+#endif
+			return true;
+		}
+
+		void close() noexcept
+		{
+#ifdef _WIN32
+			if (_data) UnmapViewOfFile(_data);
+			if (_mapping) CloseHandle(_mapping);
+			if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+
+			_mapping = nullptr;
+			_file = INVALID_HANDLE_VALUE;
+#else
+			if (_data) munmap(_data, _size);
+#endif
+			_data = nullptr;
+			_size = 0;
+		}
+
+		bool is_open() const noexcept
+		{
+			return _data;
+		}
+
+		u8* data() const noexcept
+		{
+			return _data;
+		}
+
+		usize size() const noexcept
+		{
+			return _size;
+		}
+
+		u8* _data = nullptr;
+		usize _size = 0;
+
+#ifdef _WIN32
+		HANDLE _file = INVALID_HANDLE_VALUE;
+		HANDLE _mapping = nullptr;
+#endif
+	};
+}
+
+#endif // !KAWA_MAPPED_FILE
@@ -103,6 +103,7 @@ namespace kawa
 				, hash(0)
 				, size(0)
 				, alignment(0)
+				, trivially_copyable(false)
 			{
 			}
 
@@ -112,6 +113,7 @@ namespace kawa
 				, hash(type_hash<T>())
 				, size(sizeof(T))
 				, alignment(alignof(T))
+				, trivially_copyable(std::is_trivially_copyable_v<T>)
 			{
 			}
 
@@ -146,6 +148,7 @@ namespace kawa
 			u64 hash;
 			usize size;
 			usize alignment;
+			bool trivially_copyable;
 		};
 		template <template <typename> class Predicate, typename Tuple>
 		struct filter_tuple;
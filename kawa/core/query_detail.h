@@ -0,0 +1,253 @@
+#ifndef KAWA_QUERY_DETAIL
+#define KAWA_QUERY_DETAIL
+
+#include "core_types.h"
+#include "macros.h"
+#include "entity_id.h"
+#include "soa.h"
+#include "task_manager.h"
+
+namespace kawa
+{
+	// query building blocks shared by registry and static_registry, getters hand out the value of one
+	// query parameter for an entity index, the ranges run the inner loop over an index map or id range
+
+	struct _entity_id_getter
+	{
+		inline entity_id get(usize i) const noexcept
+		{
+			return i;
+		}
+
+		inline void prefetch(usize) const noexcept {}
+	};
+
+	template<typename T>
+	struct _required_getter
+	{
+		T* _data;
+
+		inline T& get(usize i) const noexcept
+		{
+			return _data[i];
+		}
+
+		inline void prefetch(usize i) const noexcept
+		{
+			kw_prefetch(_data + i);
+		}
+	};
+
+	template<typename T>
+	struct _optional_getter
+	{
+		T* _data;       
+		bool* _mask;    
+
+		inline T* get(usize i) const noexcept
+		{
+			if (_mask[i]) 
+			{
+				return _data + i;
+			}
+			return nullptr;
+		}
+
+		inline void prefetch(usize i) const noexcept
+		{
+			kw_prefetch(_mask + i);
+			kw_prefetch(_data + i);
+		}
+	};
+
+	template<typename T>
+	struct _soa_getter
+	{
+		array<u8*, _soa_traits<T>::field_count> _bases;
+
+		inline soa<T> get(usize i) const noexcept
+		{
+			return _soa_traits<T>::make_ref(_bases, i);
+		}
+
+		inline void prefetch(usize i) const noexcept
+		{
+			const soa_layout_info& info = _soa_traits<T>::info();
+
+			for (usize k = 0; k < _soa_traits<T>::field_count; k++)
+			{
+				kw_prefetch(_bases[k] + i * info.sizes[k]);
+			}
+		}
+	};
+
+	template<typename T>
+	struct _nullable_optional_getter
+	{
+		T* _data;
+		const bool* _mask;
+
+		inline T* get(usize i) const noexcept
+		{
+			if (_mask && _mask[i])
+			{
+				return _data + i;
+			}
+			return nullptr;
+		}
+
+		inline void prefetch(usize i) const noexcept
+		{
+			if (_mask)
+			{
+				kw_prefetch(_mask + i);
+				kw_prefetch(_data + i);
+			}
+		}
+	};
+
+	template<typename getters_tuple, typename mask_t, usize mask_count>
+	inline void _query_prefetch(usize i, const array<mask_t, mask_count>& masks, const getters_tuple& getters) noexcept
+	{
+		for (usize m = 0; m < mask_count; m++)
+		{
+			kw_prefetch(masks[m] + i);
+		}
+
+		std::apply([i](const auto&...getter) { (getter.prefetch(i), ...); }, getters);
+	}
+
+	template<
+		typename getters_tuple,
+		typename index_t,
+		typename Fn,
+		typename mask_t,
+		usize mask_count,
+		usize...args_idxs
+	>
+	inline void _query_range(
+		std::index_sequence<args_idxs...>,
+		const index_t* map,
+		usize begin,
+		usize end,
+		usize prefetch_distance,
+		const array<mask_t, mask_count>& masks,
+		const getters_tuple& getters,
+		Fn&& func
+	) {
+		for (usize k = begin; k < end; k++)
+		{
+			if (prefetch_distance && k + prefetch_distance < end)
+			{
+				_query_prefetch(map[k + prefetch_distance], masks, getters);
+			}
+
+			usize i = map[k];
+
+			if ([&]<usize...I>(std::index_sequence<I...>) {
+				return (true && ... && masks[I][i]);
+			}(std::make_index_sequence<mask_count>{}))
+			{
+				func(
+					std::get<args_idxs>(getters).get(i)...
+				);
+			}
+		}
+	}
+
+	// walks entity ids in ascending order instead of a storage's indirect map, so the visiting order
+	// only depends on which entities match and not on insertion and erase history
+	template<
+		typename getters_tuple,
+		typename Fn,
+		usize mask_count,
+		usize...args_idxs
+	>
+	inline void _query_id_range(
+		std::index_sequence<args_idxs...>,
+		usize begin,
+		usize end,
+		const array<bool*, mask_count>& masks,
+		const getters_tuple& getters,
+		Fn&& func
+	) {
+		for (usize i = begin; i < end; i++)
+		{
+			if ([&]<usize...I>(std::index_sequence<I...>) {
+				return (true && ... && masks[I][i]);
+			}(std::make_index_sequence<mask_count>{}))
+			{
+				func(
+					std::get<args_idxs>(getters).get(i)...
+				);
+			}
+		}
+	}
+
+	template<typename storage_t, typename mask_t, usize count>
+	inline storage_t* _select_driver(array<storage_t*, count> storages, array<mask_t, count - 1>& out_masks) noexcept
+	{
+		usize driver_index = 0;
+
+		for (usize i = 0; i < count; i++)
+		{
+			if (storages[i]->_occupied < storages[driver_index]->_occupied)
+			{
+				driver_index = i;
+			}
+		}
+
+		storage_t* driver = storages[driver_index];
+
+		storages[driver_index] = storages[count - 1];
+
+		for (usize i = 0; i < count - 1; i++)
+		{
+			out_masks[i] = storages[i]->_mask;
+		}
+
+		return driver;
+	}
+
+	// splits [0, count) into work_groups contiguous slices, body(group_id, begin, end) runs once per slice,
+	// a manager without workers would never pick them up so the caller runs them in group order instead
+	template<typename Body>
+	inline void _schedule_slices(
+		task_manager& mgr,
+		task_schedule_policy policy,
+		usize work_groups,
+		usize count,
+		dyn_array<task_handle>& out_handles,
+		const Body& body
+	) {
+		kw_verify_msg(work_groups, "{}", "parallel queries need at least one work group");
+
+		usize work_reminder = count % work_groups;
+		usize work_per_group = count / work_groups;
+
+		for (usize group_id = 0; group_id < work_groups; group_id++)
+		{
+			usize begin = group_id * work_per_group;
+			usize end = begin + work_per_group + ((group_id == work_groups - 1) ? work_reminder : 0);
+
+			if (!mgr.worker_count())
+			{
+				body(group_id, begin, end);
+				out_handles.emplace_back();
+				continue;
+			}
+
+			out_handles.emplace_back(
+				mgr.schedule(
+					[=]()
+					{
+						body(group_id, begin, end);
+					}
+					, policy
+				)
+			);
+		}
+	}
+}
+
+#endif // !KAWA_QUERY_DETAIL
@@ -0,0 +1,199 @@
+#ifndef KAWA_SOA
+#define KAWA_SOA
+
+#include <algorithm>
+
+#include "core_types.h"
+
+namespace kawa
+{
+	constexpr usize soa_max_fields = 16;
+
+	// field k of a storage with capacity n starts at n * array_offsets[k], arrays are ordered
+	// by descending alignment so each of them stays aligned whatever the capacity is
+	struct soa_layout_info
+	{
+		usize field_count = 0;
+		array<usize, soa_max_fields> sizes{};
+		array<usize, soa_max_fields> member_offsets{};
+		array<usize, soa_max_fields> array_offsets{};
+	};
+
+	template<typename T>
+	struct soa_layout
+	{
+		constexpr static bool enabled = false;
+	};
+
+	template<typename T>
+	constexpr bool is_soa_v = soa_layout<std::remove_cv_t<T>>::enabled;
+
+	template<typename T>
+	using soa = typename soa_layout<std::remove_cv_t<T>>::ref;
+
+	template<typename T>
+	struct _is_soa_ref : std::false_type {};
+
+	template<typename T>
+		requires requires { typename T::_soa_component; }
+	struct _is_soa_ref<T> : std::true_type {};
+
+	template<typename T, bool = is_soa_v<T>>
+	struct _component_ref
+	{
+		using type = T&;
+	};
+
+	template<typename T>
+	struct _component_ref<T, true>
+	{
+		using type = soa<T>;
+	};
+
+	template<typename T>
+	using component_ref = typename _component_ref<T>::type;
+
+	template<typename T>
+	struct _member_traits;
+
+	template<typename C, typename M>
+	struct _member_traits<M C::*>
+	{
+		using class_t = C;
+		using value_t = M;
+	};
+
+	template<typename First, typename...Rest>
+	constexpr tuple<Rest...> _soa_drop_first(const tuple<First, Rest...>& t) noexcept
+	{
+		return std::apply([](const First&, const Rest&...rest) { return tuple<Rest...>(rest...); }, t);
+	}
+
+	template<typename T>
+	struct _soa_traits
+	{
+		using layout = soa_layout<T>;
+
+		constexpr static usize field_count = std::tuple_size_v<std::remove_cvref_t<decltype(layout::members)>>;
+
+		template<usize I>
+		using field_t = std::remove_cvref_t<decltype(std::declval<T&>().*std::get<I>(layout::members))>;
+
+		static_assert(std::is_trivially_copyable_v<T>, "soa components have to be trivially copyable");
+		static_assert(field_count <= soa_max_fields, "too many soa fields, raise soa_max_fields");
+		static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "over aligned soa components are not supported");
+
+		static const soa_layout_info& info() noexcept
+		{
+			static const soa_layout_info out = []()
+			{
+				soa_layout_info i;
+				i.field_count = field_count;
+
+				array<usize, field_count> alignments{};
+				array<usize, field_count> order{};
+
+				alignas(T) u8 probe[sizeof(T)];
+
+				[&]<usize...I>(std::index_sequence<I...>)
+				{
+					((
+						i.sizes[I] = sizeof(field_t<I>),
+						i.member_offsets[I] = (usize)((u8*)&(reinterpret_cast<T*>(probe)->*std::get<I>(layout::members)) - probe),
+						alignments[I] = alignof(field_t<I>),
+						order[I] = I
+					), ...);
+				}(std::make_index_sequence<field_count>{});
+
+				std::stable_sort(order.begin(), order.end(), [&](usize a, usize b) { return alignments[a] > alignments[b]; });
+
+				usize offset = 0;
+
+				for (usize k : order)
+				{
+					i.array_offsets[k] = offset;
+					offset += i.sizes[k];
+				}
+
+				return i;
+			}();
+
+			return out;
+		}
+
+		template<auto member>
+		constexpr static usize index_of() noexcept
+		{
+			usize out = field_count;
+
+			[&]<usize...I>(std::index_sequence<I...>)
+			{
+				([&]()
+				{
+					if constexpr (std::is_same_v<decltype(member), std::remove_cvref_t<decltype(std::get<I>(layout::members))>>)
+					{
+						if (std::get<I>(layout::members) == member) out = I;
+					}
+				}(), ...);
+			}(std::make_index_sequence<field_count>{});
+
+			return out;
+		}
+
+		template<usize...I>
+		static inline soa<T> _make_ref(const array<u8*, field_count>& bases, usize index, std::index_sequence<I...>) noexcept
+		{
+			return soa<T>{ reinterpret_cast<field_t<I>*>(bases[I])[index]... };
+		}
+
+		static inline soa<T> make_ref(const array<u8*, field_count>& bases, usize index) noexcept
+		{
+			return _make_ref(bases, index, std::make_index_sequence<field_count>{});
+		}
+
+		static array<u8*, field_count> bases(u8* storage, usize capacity) noexcept
+		{
+			const soa_layout_info& i = info();
+			array<u8*, field_count> out;
+
+			for (usize k = 0; k < field_count; k++)
+			{
+				out[k] = storage + capacity * i.array_offsets[k];
+			}
+
+			return out;
+		}
+	};
+}
+
+#define _kw_soa_member(field) , &_self::field
+#define _kw_soa_ref_member(field) decltype(_self::field)& field;
+#define _kw_soa_mirror_member(field) std::type_identity_t<decltype(_self::field)> field;
+
+// opts a trivially copyable component into field-wise storage, every data member has to be listed in
+// declaration order (a struct rebuilt from the listed members must come out as big as the component),
+// each gets its own contiguous array and queries take soa<type> proxies referencing the fields in place,
+// use in the global namespace:
+//
+// struct position { float x, y, z; };
+// kw_soa(position, x, y, z);
+#define kw_soa(type, ...)\
+template<>\
+struct kawa::soa_layout<type>\
+{\
+	using _self = type;\
+	constexpr static bool enabled = true;\
+	constexpr static auto members = kawa::_soa_drop_first(std::make_tuple(0 kw_for_each(_kw_soa_member, __VA_ARGS__)));\
+	struct _mirror\
+	{\
+		kw_for_each(_kw_soa_mirror_member, __VA_ARGS__)\
+	};\
+	static_assert(sizeof(_mirror) == sizeof(type), "kw_soa(" #type ", ...) has to list every data member in declaration order");\
+	struct ref\
+	{\
+		using _soa_component = type;\
+		kw_for_each(_kw_soa_ref_member, __VA_ARGS__)\
+	};\
+}
+
+#endif // !KAWA_SOA
@@ -18,7 +18,7 @@ namespace kawa
 	struct stable_tuple<>
 	{
 		template<usize index>
-		struct arg_at { static_assert(false); };
+		struct arg_at { static_assert(index != index, "stable tuple index out of bounds"); };
 
 		template<usize index>
 		using arg_at_t = arg_at<index>::type;
@@ -30,13 +30,13 @@ namespace kawa
 		template<usize i>
 		decltype(auto) get() noexcept
 		{
-			static_assert(false, "stable tuple index out of bounds");
+			static_assert(i != i, "stable tuple index out of bounds");
 		}
 
 		template<usize i>
 		decltype(auto) get() const noexcept
 		{
-			static_assert(false, "stable tuple index out of bounds");
+			static_assert(i != i, "stable tuple index out of bounds");
 		}
 
 		template<typename for_each_fn_t>
@@ -57,10 +57,11 @@ namespace kawa
 	struct stable_tuple<head_t>
 	{
 		template<usize index>
-		struct arg_at { static_assert(false); };
-
-		template<>
-		struct arg_at<0> { using type = head_t; };
+		struct arg_at
+		{
+			static_assert(index == 0, "stable tuple index out of bounds");
+			using type = head_t;
+		};
 
 		template<usize index>
 		using arg_at_t = arg_at<index>::type;
@@ -86,7 +87,7 @@ namespace kawa
 			}
 			else
 			{
-				static_assert(false, "stable tuple index out of bounds");
+				static_assert(i == 0, "stable tuple index out of bounds");
 			}
 		}
 
@@ -99,7 +100,7 @@ namespace kawa
 			}
 			else
 			{
-				static_assert(false, "stable tuple index out of bounds");
+				static_assert(i == 0, "stable tuple index out of bounds");
 			}
 		}
 
@@ -129,10 +130,11 @@ namespace kawa
 		using rest_tuple_t = stable_tuple<rest_t...>;
 
 		template<usize index>
-		struct arg_at { using type = rest_tuple_t::template arg_at<index - 1>::type; };
+		struct arg_at { using type = typename rest_tuple_t::template arg_at<index - 1>::type; };
 
-		template<>
-		struct arg_at<0> { using type = head_t; };
+		template<usize index>
+			requires (index == 0)
+		struct arg_at<index> { using type = head_t; };
 
 		template<usize index>
 		using arg_at_t = arg_at<index>::type;
@@ -160,7 +162,7 @@ namespace kawa
 			}
 			else
 			{
-				return rest.get<i - 1>();
+				return rest.template get<i - 1>();
 			}
 		}
 
@@ -173,7 +175,7 @@ namespace kawa
 			}
 			else
 			{
-				return rest.get<i - 1>();
+				return rest.template get<i - 1>();
 			}
 		}
 
@@ -0,0 +1,462 @@
+#ifndef KAWA_STATIC_REGISTRY
+#define KAWA_STATIC_REGISTRY
+
+#include "core_types.h"
+#include "macros.h"
+#include "indirect_array.h"
+#include "stable_tuple.h"
+#include "task_manager.h"
+#include "query_detail.h"
+#include "ecs.h"
+
+namespace kawa
+{
+	// registry over a component list known up front, every storage is a strongly typed indirect_array
+	// resolved at compile time, so there is no storage lookup, no type erased lifetime vtable and no
+	// lifetime hooks, queries share their traits and inner loop with registry
+	template<typename...Components>
+	struct static_registry
+	{
+		struct config
+		{
+			string name = "unnamed";
+			usize max_entity_count = 128;
+			usize prefetch_distance = 8;
+			memory_resource* resource = default_memory_resource();
+		};
+
+		static_registry(const config& cfg)
+			: _storages(indirect_array<Components>(cfg.max_entity_count, cfg.resource)...)
+			, _free_list(cfg.max_entity_count, cfg.resource)
+			, _entries(cfg.max_entity_count, cfg.resource)
+			, _cfg(cfg)
+		{
+		}
+
+		template<typename T>
+		constexpr static usize _index_of() noexcept
+		{
+			usize out = sizeof...(Components);
+			usize i = 0;
+
+			((std::is_same_v<T, Components> ? (out = i++) : i++), ...);
+
+			return out;
+		}
+
+		template<typename T>
+		constexpr static bool contains_component = _index_of<T>() < sizeof...(Components);
+
+		template<typename T>
+		indirect_array<T>& storage() noexcept
+		{
+			static_assert(contains_component<T>, "component is not part of this static_registry");
+
+			return _storages.template get<_index_of<T>()>();
+		}
+
+		template<typename T>
+		const indirect_array<T>& storage() const noexcept
+		{
+			static_assert(contains_component<T>, "component is not part of this static_registry");
+
+			return _storages.template get<_index_of<T>()>();
+		}
+
+		usize entity_count() const noexcept
+		{
+			return _entries._occupied;
+		}
+
+		template<typename...Args>
+		entity_id entity(Args&&...args)
+		{
+			entity_id id;
+
+			if (!_free_list.empty())
+			{
+				usize top = _free_list.occupied() - 1;
+				id = _free_list[top];
+				_free_list.erase(top);
+			}
+			else if (_id_counter < _cfg.max_entity_count)
+			{
+				id = _id_counter++;
+			}
+
+			kw_assert(id.is_valid());
+
+			_entries.emplace(id);
+
+			((emplace<std::remove_cvref_t<Args>>(id, std::forward<Args>(args))), ...);
+
+			return id;
+		}
+
+		void destroy(entity_id id)
+		{
+			if (!_entries.contains(id)) return;
+
+			_storages.for_each([id](auto& s) { s.erase(id); });
+
+			_entries.erase(id);
+			_free_list.emplace(_free_list.occupied(), id);
+		}
+
+		template<typename T, typename...Args>
+		T& emplace(entity_id e, Args&&...args)
+		{
+			return storage<T>().emplace(e, std::forward<Args>(args)...);
+		}
+
+		template<typename T>
+		std::remove_cvref_t<T>& add(entity_id e, T&& v)
+		{
+			return storage<std::remove_cvref_t<T>>().emplace(e, std::forward<T>(v));
+		}
+
+		template<typename...Args>
+		void erase(entity_id e)
+		{
+			((storage<Args>().erase(e)), ...);
+		}
+
+		template<typename T>
+		T& get(entity_id e)
+		{
+			return storage<T>().get(e);
+		}
+
+		template<typename T>
+		const T& get(entity_id e) const
+		{
+			return storage<T>().get(e);
+		}
+
+		template<typename T>
+		T* try_get(entity_id e)
+		{
+			return storage<T>().try_get(e);
+		}
+
+		template<typename T>
+		const T* try_get(entity_id e) const
+		{
+			return storage<T>().try_get(e);
+		}
+
+		template<typename...Args>
+		bool has(entity_id e) const noexcept
+		{
+			return ((storage<Args>().contains(e)) && ...);
+		}
+
+		template<typename...Args>
+		void copy(entity_id from, entity_id to)
+		{
+			((storage<Args>().emplace(to, storage<Args>().get(from))), ...);
+		}
+
+		template<typename...Args>
+		void move(entity_id from, entity_id to)
+		{
+			((storage<Args>().emplace(to, std::move(storage<Args>().get(from))), storage<Args>().erase(from)), ...);
+		}
+
+		void clone(entity_id from, entity_id to)
+		{
+			_storages.for_each(
+				[from, to](auto& s)
+				{
+					if (s.contains(from))
+					{
+						s.emplace(to, s.get(from));
+					}
+				}
+			);
+		}
+
+		entity_id clone(entity_id from)
+		{
+			entity_id to = entity();
+
+			clone(from, to);
+
+			return to;
+		}
+
+		template<typename Fn>
+		void query(Fn&& func)
+		{
+			using q = registry::query_traits<Fn>;
+
+			_query_impl<Fn, typename q::dirty_args, typename q::clean_require_args>(
+				*this,
+				std::make_index_sequence<std::tuple_size_v<typename q::dirty_args>>{},
+				std::make_index_sequence<std::tuple_size_v<typename q::clean_require_args>>{},
+				std::forward<Fn>(func)
+			);
+		}
+
+		template<typename Fn>
+		void query(Fn&& func) const
+		{
+			using q = registry::query_traits<Fn>;
+
+			static_assert(q::is_read_only, "const queries can only take entity_id, const references and const pointers");
+
+			_query_impl<Fn, typename q::dirty_args, typename q::clean_require_args>(
+				*this,
+				std::make_index_sequence<std::tuple_size_v<typename q::dirty_args>>{},
+				std::make_index_sequence<std::tuple_size_v<typename q::clean_require_args>>{},
+				std::forward<Fn>(func)
+			);
+		}
+
+		template<typename Fn>
+		void query_with(entity_id id, Fn&& func)
+		{
+			query_with(span<const entity_id>(&id, 1), std::forward<Fn>(func));
+		}
+
+		template<typename Fn>
+		void query_with(span<const entity_id> ids, Fn&& func)
+		{
+			using q = registry::query_traits<Fn>;
+
+			_query_with_impl<Fn, typename q::dirty_args, typename q::clean_require_args>(
+				*this,
+				std::make_index_sequence<std::tuple_size_v<typename q::dirty_args>>{},
+				std::make_index_sequence<std::tuple_size_v<typename q::clean_require_args>>{},
+				ids,
+				std::forward<Fn>(func)
+			);
+		}
+
+		template<typename Fn>
+		void query_with(entity_id id, Fn&& func) const
+		{
+			query_with(span<const entity_id>(&id, 1), std::forward<Fn>(func));
+		}
+
+		template<typename Fn>
+		void query_with(span<const entity_id> ids, Fn&& func) const
+		{
+			using q = registry::query_traits<Fn>;
+
+			static_assert(q::is_read_only, "const queries can only take entity_id, const references and const pointers");
+
+			_query_with_impl<Fn, typename q::dirty_args, typename q::clean_require_args>(
+				*this,
+				std::make_index_sequence<std::tuple_size_v<typename q::dirty_args>>{},
+				std::make_index_sequence<std::tuple_size_v<typename q::clean_require_args>>{},
+				ids,
+				std::forward<Fn>(func)
+			);
+		}
+
+		template<typename Fn>
+		void query_par(task_manager& tm, task_schedule_policy policy, usize work_groups, dyn_array<task_handle>& out_handles, Fn&& func)
+		{
+			using q = registry::query_traits<Fn>;
+
+			_query_par_impl<Fn, typename q::dirty_args, typename q::clean_require_args>(
+				std::make_index_sequence<std::tuple_size_v<typename q::dirty_args>>{},
+				std::make_index_sequence<std::tuple_size_v<typename q::clean_require_args>>{},
+				tm,
+				policy,
+				work_groups,
+				out_handles,
+				std::forward<Fn>(func)
+			);
+		}
+
+		template<typename T, typename self_t>
+		static auto _make_getter(self_t& self) noexcept
+		{
+			using CVT = std::remove_reference_t<std::remove_pointer_t<T>>;
+			using CleanT = std::remove_cv_t<CVT>;
+
+			static_assert(!_is_soa_ref<std::remove_cvref_t<T>>::value, "static_registry stores soa components packed, query them by reference");
+
+			if constexpr (std::is_same_v<entity_id, std::remove_cvref_t<T>>)
+			{
+				return _entity_id_getter{};
+			}
+			else if constexpr (std::is_pointer_v<T>)
+			{
+				auto& s = self.template storage<CleanT>();
+
+				if constexpr (std::is_const_v<self_t>)
+				{
+					return _nullable_optional_getter<CVT>{ (CVT*)s._storage, s._mask };
+				}
+				else
+				{
+					return _optional_getter<CVT>{ (CVT*)s._storage, s._mask };
+				}
+			}
+			else if constexpr (std::is_reference_v<T>)
+			{
+				auto& s = self.template storage<CleanT>();
+				return _required_getter<CVT>{ (CVT*)s._storage };
+			}
+		}
+
+		template<typename require_tuple, typename self_t, usize...require_idxs>
+		static auto _required_storages(self_t& self, std::index_sequence<require_idxs...>) noexcept
+		{
+			using base_t = std::conditional_t<std::is_const_v<self_t>, const indirect_array_base, indirect_array_base>;
+
+			return array<base_t*, sizeof...(require_idxs)>{
+				static_cast<base_t*>(&self.template storage<std::tuple_element_t<require_idxs, require_tuple>>())...
+			};
+		}
+
+		template<
+			typename Fn,
+			typename dirty_args_tuple,
+			typename require_tuple,
+			typename self_t,
+			usize...args_idxs,
+			usize...require_idxs
+		>
+		static void _query_impl(
+			self_t& self,
+			std::index_sequence<args_idxs...>,
+			std::index_sequence<require_idxs...>,
+			Fn&& func
+		) {
+			auto getters = std::make_tuple(
+				_make_getter<std::tuple_element_t<args_idxs, dirty_args_tuple>>(self)...
+			);
+
+			if constexpr (sizeof...(require_idxs) == 0)
+			{
+				_query_range(
+					std::index_sequence<args_idxs...>{},
+					self._entries._indirect_map,
+					0,
+					self._entries._occupied,
+					self._cfg.prefetch_distance,
+					array<const bool*, 0>{},
+					getters,
+					func
+				);
+			}
+			else
+			{
+				auto required_storages = _required_storages<require_tuple>(self, std::index_sequence<require_idxs...>{});
+
+				array<const bool*, sizeof...(require_idxs) - 1> required_storage_masks;
+				auto driver = _select_driver(required_storages, required_storage_masks);
+
+				_query_range(
+					std::index_sequence<args_idxs...>{},
+					driver->_indirect_map,
+					0,
+					driver->_occupied,
+					self._cfg.prefetch_distance,
+					required_storage_masks,
+					getters,
+					func
+				);
+			}
+		}
+
+		template<
+			typename Fn,
+			typename dirty_args_tuple,
+			typename require_tuple,
+			typename self_t,
+			usize...args_idxs,
+			usize...require_idxs
+		>
+		static void _query_with_impl(
+			self_t& self,
+			std::index_sequence<args_idxs...>,
+			std::index_sequence<require_idxs...>,
+			span<const entity_id> ids,
+			Fn&& func
+		) {
+			auto getters = std::make_tuple(
+				_make_getter<std::tuple_element_t<args_idxs, dirty_args_tuple>>(self)...
+			);
+
+			array<const bool*, sizeof...(require_idxs)> required_storage_masks = {
+				self.template storage<std::tuple_element_t<require_idxs, require_tuple>>()._mask...
+			};
+
+			_query_range(
+				std::index_sequence<args_idxs...>{},
+				ids.data(),
+				0,
+				ids.size(),
+				self._cfg.prefetch_distance,
+				required_storage_masks,
+				getters,
+				func
+			);
+		}
+
+		template<
+			typename Fn,
+			typename dirty_args_tuple,
+			typename require_tuple,
+			usize...args_idxs,
+			usize...require_idxs
+		>
+		void _query_par_impl(
+			std::index_sequence<args_idxs...>,
+			std::index_sequence<require_idxs...>,
+			task_manager& mgr,
+			task_schedule_policy policy,
+			usize work_groups,
+			dyn_array<task_handle>& out_handles,
+			Fn&& func
+		) {
+			auto getters = std::make_tuple(
+				_make_getter<std::tuple_element_t<args_idxs, dirty_args_tuple>>(*this)...
+			);
+
+			const usize* map = _entries._indirect_map;
+			usize count = _entries._occupied;
+			array<bool*, (sizeof...(require_idxs) ? sizeof...(require_idxs) - 1 : 0)> required_storage_masks{};
+
+			if constexpr (sizeof...(require_idxs) > 0)
+			{
+				auto required_storages = _required_storages<require_tuple>(*this, std::index_sequence<require_idxs...>{});
+				indirect_array_base* driver = _select_driver(required_storages, required_storage_masks);
+
+				map = driver->_indirect_map;
+				count = driver->_occupied;
+			}
+
+			usize prefetch_distance = _cfg.prefetch_distance;
+
+			_schedule_slices(mgr, policy, work_groups, count, out_handles,
+				[=](usize, usize begin, usize end)
+				{
+					_query_range(
+						std::index_sequence<args_idxs...>{},
+						map,
+						begin,
+						end,
+						prefetch_distance,
+						required_storage_masks,
+						getters,
+						func
+					);
+				}
+			);
+		}
+
+		stable_tuple<indirect_array<Components>...> _storages;
+		indirect_array<entity_id> _free_list;
+		indirect_array<entity_id> _entries;
+		entity_id _id_counter = 0;
+		config _cfg;
+	};
+}
+
+#endif // !KAWA_STATIC_REGISTRY
@@ -0,0 +1,293 @@
+#ifndef KAWA_TASK_FN
+#define KAWA_TASK_FN
+
+#include <bit>
+#include <new>
+#include "core_types.h"
+
+#ifndef kw_task_inline_capacity
+#define kw_task_inline_capacity 112
+#endif
+
+namespace kawa
+{
+	// per thread caches of freed blocks for captures too big to live inside a task_fn, one list per power of two
+	// size class, blocks are usually freed on the worker that ran the task rather than the thread that scheduled
+	// it, so a full cache and the cache of an exiting thread hand their blocks to a shared list per class that
+	// an empty cache takes over as a whole, the shared lists are only pushed to and emptied with one exchange
+	// so they don't suffer from aba
+	struct _task_fn_heap
+	{
+		constexpr static usize min_class_shift = 7;
+		constexpr static usize class_count = 6;
+		constexpr static usize max_cached = 64;
+		constexpr static usize block_alignment = alignof(std::max_align_t);
+
+		struct block
+		{
+			block* next;
+		};
+
+		// never destroyed so threads exiting during static destruction can still hand their blocks back
+		inline static array<atomic<block*>, class_count> shared{};
+
+		static void give_back(usize c, block* b) noexcept
+		{
+			block* head = shared[c].load(std::memory_order_relaxed);
+
+			do
+			{
+				b->next = head;
+			} while (!shared[c].compare_exchange_weak(head, b, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		struct cache
+		{
+			~cache() noexcept
+			{
+				for (usize c = 0; c < class_count; c++)
+				{
+					while (block* b = heads[c])
+					{
+						heads[c] = b->next;
+						give_back(c, b);
+					}
+				}
+			}
+
+			array<block*, class_count> heads{};
+			array<usize, class_count> counts{};
+		};
+
+		static usize size_class(usize size) noexcept
+		{
+			usize shift = std::bit_width(std::max<usize>(size, 1) - 1);
+			return shift <= min_class_shift ? 0 : shift - min_class_shift;
+		}
+
+		static cache& local() noexcept
+		{
+			thread_local cache c;
+			return c;
+		}
+
+		static bool cacheable(usize c, usize alignment) noexcept
+		{
+			return c < class_count && alignment <= block_alignment;
+		}
+
+		static void* allocate(usize size, usize alignment)
+		{
+			usize c = size_class(size);
+
+			if (!cacheable(c, alignment))
+			{
+				return ::operator new(size, std::align_val_t{ std::max(alignment, block_alignment) });
+			}
+
+			cache& local_cache = local();
+
+			if (!local_cache.heads[c])
+			{
+				block* list = shared[c].exchange(nullptr, std::memory_order_acquire);
+
+				local_cache.heads[c] = list;
+
+				for (; list; list = list->next)
+				{
+					local_cache.counts[c]++;
+				}
+			}
+
+			if (block* b = local_cache.heads[c])
+			{
+				local_cache.heads[c] = b->next;
+				local_cache.counts[c]--;
+				return b;
+			}
+
+			return ::operator new(usize(1) << (c + min_class_shift), std::align_val_t{ block_alignment });
+		}
+
+		static void deallocate(void* ptr, usize size, usize alignment) noexcept
+		{
+			usize c = size_class(size);
+
+			if (!cacheable(c, alignment))
+			{
+				::operator delete(ptr, std::align_val_t{ std::max(alignment, block_alignment) });
+				return;
+			}
+
+			cache& local_cache = local();
+
+			if (local_cache.counts[c] < max_cached)
+			{
+				local_cache.heads[c] = new (ptr) block{ local_cache.heads[c] };
+				local_cache.counts[c]++;
+				return;
+			}
+
+			give_back(c, new (ptr) block{ nullptr });
+		}
+	};
+
+	// move only void() callable, captures up to inline_capacity bytes are stored in place so scheduling
+	// them never allocates, bigger ones go through _task_fn_heap, override kw_task_inline_capacity to tune
+	class task_fn
+	{
+	public:
+		constexpr static usize inline_capacity = kw_task_inline_capacity;
+
+		template<typename Fn>
+		constexpr static bool fits_inline =
+			sizeof(Fn) <= inline_capacity &&
+			alignof(Fn) <= alignof(std::max_align_t) &&
+			std::is_nothrow_move_constructible_v<Fn>;
+
+		task_fn() noexcept = default;
+		task_fn(std::nullptr_t) noexcept {}
+
+		template<typename Fn>
+			requires (!std::is_same_v<std::remove_cvref_t<Fn>, task_fn> && std::is_invocable_r_v<void, std::decay_t<Fn>&>)
+		task_fn(Fn&& fn)
+		{
+			using fn_t = std::decay_t<Fn>;
+
+			if constexpr (fits_inline<fn_t>)
+			{
+				new (_storage) fn_t(std::forward<Fn>(fn));
+			}
+			else
+			{
+				void* ptr = _task_fn_heap::allocate(sizeof(fn_t), alignof(fn_t));
+				*reinterpret_cast<fn_t**>(_storage) = new (ptr) fn_t(std::forward<Fn>(fn));
+			}
+
+			_vtable = &_vtable_for<fn_t>;
+		}
+
+		task_fn(const task_fn&) = delete;
+		task_fn& operator=(const task_fn&) = delete;
+
+		task_fn(task_fn&& other) noexcept
+		{
+			_take(other);
+		}
+
+		task_fn& operator=(task_fn&& other) noexcept
+		{
+			if (this != &other)
+			{
+				release();
+				_take(other);
+			}
+
+			return *this;
+		}
+
+		task_fn& operator=(std::nullptr_t) noexcept
+		{
+			release();
+			return *this;
+		}
+
+		~task_fn() noexcept
+		{
+			release();
+		}
+
+		void release() noexcept
+		{
+			if (_vtable)
+			{
+				_vtable->destroy_fn(_storage);
+				_vtable = nullptr;
+			}
+		}
+
+		void operator()()
+		{
+			kw_assert_msg(_vtable, "{}", "calling an empty task_fn");
+			_vtable->invoke_fn(_storage);
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return _vtable;
+		}
+
+		struct vtable
+		{
+			using invoke_fn_t = void(void*);
+			using move_fn_t = void(void*, void*) noexcept;
+			using destroy_fn_t = void(void*) noexcept;
+
+			invoke_fn_t* invoke_fn = nullptr;
+			move_fn_t* move_fn = nullptr;
+			destroy_fn_t* destroy_fn = nullptr;
+		};
+
+		template<typename Fn>
+		static Fn& _get(void* storage) noexcept
+		{
+			if constexpr (fits_inline<Fn>)
+			{
+				return *std::launder(reinterpret_cast<Fn*>(storage));
+			}
+			else
+			{
+				return **reinterpret_cast<Fn**>(storage);
+			}
+		}
+
+		template<typename Fn>
+		constexpr static vtable _vtable_for =
+		{
+			.invoke_fn = +[](void* storage)
+				{
+					_get<Fn>(storage)();
+				},
+
+			// inline callables are moved, heap ones only hand over their pointer
+			.move_fn = +[](void* from, void* to) noexcept
+				{
+					if constexpr (fits_inline<Fn>)
+					{
+						Fn& f = _get<Fn>(from);
+						new (to) Fn(std::move(f));
+						f.~Fn();
+					}
+					else
+					{
+						*reinterpret_cast<Fn**>(to) = *reinterpret_cast<Fn**>(from);
+					}
+				},
+
+			.destroy_fn = +[](void* storage) noexcept
+				{
+					Fn& f = _get<Fn>(storage);
+					f.~Fn();
+
+					if constexpr (!fits_inline<Fn>)
+					{
+						_task_fn_heap::deallocate(&f, sizeof(Fn), alignof(Fn));
+					}
+				},
+		};
+
+		void _take(task_fn& other) noexcept
+		{
+			if (other._vtable)
+			{
+				other._vtable->move_fn(other._storage, _storage);
+				_vtable = std::exchange(other._vtable, nullptr);
+			}
+		}
+
+		alignas(std::max_align_t) u8 _storage[inline_capacity];
+		const vtable* _vtable = nullptr;
+	};
+}
+
+#endif // !KAWA_TASK_FN
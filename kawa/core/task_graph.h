@@ -0,0 +1,177 @@
+#ifndef KAWA_TASK_GRAPH
+#define KAWA_TASK_GRAPH
+
+#include "core_types.h"
+#include "task_manager.h"
+
+namespace kawa
+{
+	// tasks with predecessors, built once and submitted as a whole (e.g. once per frame), every finished
+	// task decrements its successors' counters and schedules the ones that reach zero from the worker it
+	// ran on, so no thread sits between pipeline stages, the graph must outlive its submissions and must
+	// not be changed or resubmitted while one is running
+	struct task_graph
+	{
+		using node_id = usize;
+
+		struct node
+		{
+			task_fn fn;
+			dyn_array<node_id> successors;
+			u32 predecessor_count = 0;
+			atomic<u32> pending{ 0 };
+
+			node(task_fn&& f) noexcept : fn(std::move(f)) {}
+			node(node&& other) noexcept
+				: fn(std::move(other.fn))
+				, successors(std::move(other.successors))
+				, predecessor_count(other.predecessor_count)
+			{
+			}
+		};
+
+		node_id add(task_fn&& fn)
+		{
+			_nodes.emplace_back(std::move(fn));
+			return _nodes.size() - 1;
+		}
+
+		node_id add(task_fn&& fn, std::initializer_list<node_id> predecessors)
+		{
+			node_id id = add(std::move(fn));
+
+			for (node_id p : predecessors)
+			{
+				precede(p, id);
+			}
+
+			return id;
+		}
+
+		// after only starts once before has finished
+		void precede(node_id before, node_id after)
+		{
+			kw_assert(before < _nodes.size() && after < _nodes.size() && before != after);
+
+			_nodes[before].successors.emplace_back(after);
+			_nodes[after].predecessor_count++;
+		}
+
+		usize size() const noexcept
+		{
+			return _nodes.size();
+		}
+
+		void clear() noexcept
+		{
+			_nodes.clear();
+		}
+
+		// the returned handle finishes together with the last task of the graph
+		task_handle submit(task_manager& tm)
+		{
+			if (_nodes.empty()) return {};
+
+			kw_assert_msg(_is_acyclic(), "{}", "task_graph has a cycle");
+
+			_tm = &tm;
+			_remaining.store(_nodes.size(), std::memory_order_relaxed);
+			_done = tm._open();
+
+			for (auto& n : _nodes)
+			{
+				n.pending.store(n.predecessor_count, std::memory_order_relaxed);
+			}
+
+			task_handle done = _done;
+
+			// counters have to be reset before any root can finish
+			for (node_id id = 0; id < _nodes.size(); id++)
+			{
+				if (!_nodes[id].predecessor_count)
+				{
+					_schedule(id);
+				}
+			}
+
+			return done;
+		}
+
+		void run(task_manager& tm)
+		{
+			tm.wait(submit(tm));
+		}
+
+		void _schedule(node_id id)
+		{
+			_tm->schedule(
+				[this, id]()
+				{
+					_execute(id);
+				}
+			);
+		}
+
+		void _execute(node_id id)
+		{
+			node& n = _nodes[id];
+
+			n.fn();
+
+			for (node_id s : n.successors)
+			{
+				if (_nodes[s].pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					_schedule(s);
+				}
+			}
+
+			if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				_tm->_finish(_done);
+			}
+		}
+
+		bool _is_acyclic() const
+		{
+			dyn_array<u32> counts(_nodes.size());
+			dyn_array<node_id> ready;
+
+			for (node_id id = 0; id < _nodes.size(); id++)
+			{
+				counts[id] = _nodes[id].predecessor_count;
+
+				if (!counts[id])
+				{
+					ready.emplace_back(id);
+				}
+			}
+
+			usize visited = 0;
+
+			while (!ready.empty())
+			{
+				node_id id = ready.back();
+				ready.pop_back();
+				visited++;
+
+				for (node_id s : _nodes[id].successors)
+				{
+					if (!--counts[s])
+					{
+						ready.emplace_back(s);
+					}
+				}
+			}
+
+			return visited == _nodes.size();
+		}
+
+		dyn_array<node> _nodes;
+		atomic<usize> _remaining{ 0 };
+		task_handle _done;
+		task_manager* _tm = nullptr;
+	};
+}
+
+#endif // !KAWA_TASK_GRAPH
@@ -1,27 +1,49 @@
 #ifndef KAWA_TASK_MANAGER
 #define KAWA_TASK_MANAGER
 
-#include <semaphore>
+#include <coroutine>
+#include <mutex>
 #include "core_types.h"
+#include "task_fn.h"
 
 namespace kawa
 {
-	using task_fn = std::function<void()>;
-
-	struct alignas(64) worker_entry
+	// a coroutine suspended until the task of the given generation is finished
+	struct task_waiter
 	{
-		task_fn task = nullptr;
-		thread thread;
-		std::binary_semaphore semaphore{ 0 };
+		std::coroutine_handle<> handle;
+		u32 generation = 0;
+		task_waiter* next = nullptr;
+	};
 
+	// pooled, an odd generation means the node holds a task that is queued or running,
+	// finishing it bumps the generation so handles to it (and to older uses of the node) read as done
+	struct task_node
+	{
+		task_fn fn = nullptr;
 		atomic<u32> generation{ 0 };
+		atomic<task_waiter*> waiters{ nullptr };
+		atomic<u32> parked{ 0 };
+
+		task_node* next = nullptr;
+		atomic<u32> next_free{ 0 };
+		u32 index = 0;
 	};
 
-	struct task_handle 
+	struct task_handle
 	{
-		constexpr static u32 _invalid_worker = std::numeric_limits<u32>::max();
-		u32 worker = 0;
+		task_node* node = nullptr;
 		u32 generation = 0;
+
+		bool valid() const noexcept
+		{
+			return node;
+		}
+
+		bool done() const noexcept
+		{
+			return !node || node->generation.load(std::memory_order_acquire) != generation;
+		}
 	};
 
 	enum class task_schedule_policy
@@ -31,9 +53,237 @@ namespace kawa
 		try_schedule
 	};
 
+	// lock free node pool, nodes are never returned to the os before the pool dies so a stale handle
+	// can always read its node's generation, the free list head carries a tag against aba
+	struct task_pool
+	{
+		constexpr static usize chunk_size = 1024;
+		constexpr static usize max_chunks = 4096;
+
+		task_pool() noexcept = default;
+
+		task_pool(const task_pool&) = delete;
+		task_pool& operator=(const task_pool&) = delete;
+
+		~task_pool() noexcept
+		{
+			for (usize i = 0; i < _chunk_count.load(std::memory_order_acquire); i++)
+			{
+				delete[] _chunks[i].load(std::memory_order_relaxed);
+			}
+		}
+
+		task_node& node(u32 index) noexcept
+		{
+			return _chunks[index / chunk_size].load(std::memory_order_acquire)[index % chunk_size];
+		}
+
+		task_node* acquire()
+		{
+			u64 head = _free_head.load(std::memory_order_acquire);
+
+			while (true)
+			{
+				u32 top = (u32)head;
+
+				if (!top)
+				{
+					_grow();
+					head = _free_head.load(std::memory_order_acquire);
+					continue;
+				}
+
+				task_node& n = node(top - 1);
+				u64 next = (((head >> 32) + 1) << 32) | n.next_free.load(std::memory_order_relaxed);
+
+				if (_free_head.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					return &n;
+				}
+			}
+		}
+
+		void release(task_node* n) noexcept
+		{
+			u64 head = _free_head.load(std::memory_order_relaxed);
+
+			do
+			{
+				n->next_free.store((u32)head, std::memory_order_relaxed);
+			} while (!_free_head.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | (n->index + 1), std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		void _grow()
+		{
+			std::lock_guard lock(_grow_mutex);
+
+			if ((u32)_free_head.load(std::memory_order_acquire)) return;
+
+			usize chunk = _chunk_count.load(std::memory_order_relaxed);
+
+			kw_assert_msg(chunk < max_chunks, "task pool exhausted, max is {} tasks in flight", chunk_size * max_chunks);
+
+			task_node* nodes = new task_node[chunk_size];
+
+			for (usize i = 0; i < chunk_size; i++)
+			{
+				nodes[i].index = (u32)(chunk * chunk_size + i);
+			}
+
+			_chunks[chunk].store(nodes, std::memory_order_release);
+			_chunk_count.store(chunk + 1, std::memory_order_release);
+
+			for (usize i = 0; i < chunk_size; i++)
+			{
+				release(nodes + i);
+			}
+		}
+
+		array<atomic<task_node*>, max_chunks> _chunks{};
+		atomic<usize> _chunk_count{ 0 };
+		atomic<u64> _free_head{ 0 };
+		std::mutex _grow_mutex;
+	};
+
+	// chase-lev deque, only the owning worker pushes and pops at the bottom, everyone else steals from the top,
+	// rings are grown by the owner and the old ones are kept alive since a thief may still be reading them
+	struct task_deque
+	{
+		struct ring
+		{
+			ring(i64 cap) noexcept
+				: capacity(cap)
+				, slots(new atomic<task_node*>[cap])
+			{
+			}
+
+			task_node* get(i64 i) const noexcept
+			{
+				return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+			}
+
+			void put(i64 i, task_node* n) noexcept
+			{
+				slots[i & (capacity - 1)].store(n, std::memory_order_relaxed);
+			}
+
+			i64 capacity;
+			unique<atomic<task_node*>[]> slots;
+		};
+
+		task_deque(i64 capacity = 256)
+		{
+			_rings.emplace_back(std::make_unique<ring>(capacity));
+			_ring.store(_rings.back().get(), std::memory_order_relaxed);
+		}
+
+		void push(task_node* n)
+		{
+			i64 b = _bottom.load(std::memory_order_relaxed);
+			i64 t = _top.load(std::memory_order_acquire);
+			ring* r = _ring.load(std::memory_order_relaxed);
+
+			if (b - t > r->capacity - 1)
+			{
+				ring* grown = _rings.emplace_back(std::make_unique<ring>(r->capacity * 2)).get();
+
+				for (i64 i = t; i < b; i++)
+				{
+					grown->put(i, r->get(i));
+				}
+
+				_ring.store(grown, std::memory_order_release);
+				r = grown;
+			}
+
+			r->put(b, n);
+			_bottom.store(b + 1, std::memory_order_release);
+		}
+
+		task_node* pop() noexcept
+		{
+			i64 b = _bottom.load(std::memory_order_relaxed) - 1;
+			ring* r = _ring.load(std::memory_order_relaxed);
+			_bottom.store(b, std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			i64 t = _top.load(std::memory_order_relaxed);
+
+			if (t > b)
+			{
+				_bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			task_node* out = r->get(b);
+
+			if (t == b)
+			{
+				if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					out = nullptr;
+				}
+
+				_bottom.store(b + 1, std::memory_order_relaxed);
+			}
+
+			return out;
+		}
+
+		bool empty() const noexcept
+		{
+			return _bottom.load(std::memory_order_seq_cst) <= _top.load(std::memory_order_seq_cst);
+		}
+
+		// lost races set retry, the deque may still hold work in that case
+		task_node* steal(bool& retry) noexcept
+		{
+			i64 t = _top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			i64 b = _bottom.load(std::memory_order_acquire);
+
+			if (t >= b) return nullptr;
+
+			ring* r = _ring.load(std::memory_order_acquire);
+			task_node* out = r->get(t);
+
+			if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				retry = true;
+				return nullptr;
+			}
+
+			return out;
+		}
+
+		alignas(64) atomic<i64> _top{ 0 };
+		alignas(64) atomic<i64> _bottom{ 0 };
+		atomic<ring*> _ring{ nullptr };
+		dyn_array<unique<ring>> _rings;
+	};
+
+	class task_manager;
+
+	struct alignas(64) worker_entry
+	{
+		task_deque deque;
+		kawa::thread thread;
+		usize index = 0;
+	};
+
+	inline thread_local worker_entry* _current_worker = nullptr;
+	inline thread_local task_manager* _current_manager = nullptr;
+
+	// every worker owns a work stealing deque, tasks scheduled from a worker go to its own deque,
+	// tasks from any other thread go to a shared injection stack that idle workers take over in one go,
+	// scheduling never blocks, a thread waiting on a worker executes other tasks in the meantime,
+	// idle workers and waiting threads spin for a short while and then park on an atomic wait
 	class task_manager
 	{
 	public:
+		constexpr static usize spin_count = 64;
+
 		task_manager(usize worker_count) noexcept
 		{
 			_workers.reserve(worker_count);
@@ -41,108 +291,380 @@ namespace kawa
 			for (usize i = 0; i < worker_count; i++)
 			{
 				auto& w = _workers.emplace_back(new worker_entry());
+				w->index = i;
+			}
 
+			for (auto w : _workers)
+			{
 				w->thread = std::move(thread(worker_loop, std::ref(*this), std::ref(*w)));
 			}
 		}
 
 		~task_manager() noexcept
 		{
-			exit.store(true, std::memory_order_release);
+			exit.store(true, std::memory_order_seq_cst);
+
+			_work_epoch.fetch_add(1, std::memory_order_seq_cst);
+			_work_epoch.notify_all();
 
-			for (auto w : _workers) w->semaphore.release();
 			for (auto w : _workers) w->thread.join();
 			for (auto w : _workers) delete w;
 		}
 
 		void static worker_loop(task_manager& manager, worker_entry& worker) noexcept
 		{
+			_current_worker = &worker;
+			_current_manager = &manager;
+
+			usize idle_rounds = 0;
+
 			while (true)
 			{
-				worker.semaphore.acquire();
+				if (task_node* n = manager._find_work(worker))
+				{
+					manager._run(n);
+					idle_rounds = 0;
+					continue;
+				}
 
 				if (manager.exit.load(std::memory_order_acquire)) return;
 
-				if (worker.task)
+				if (idle_rounds++ < spin_count)
 				{
-					worker.task();
+					kw_cpu_relax();
+					continue;
 				}
 
-				worker.generation.fetch_add(1, std::memory_order_release);
+				idle_rounds = 0;
+				manager._sleep();
 			}
 		}
 
-		task_handle schedule(task_fn&& task, task_schedule_policy policy = task_schedule_policy::wait_if_neccesary) noexcept
+		// a submitter either sees the sleeper count raised or the sleeper sees the new task, and the epoch
+		// read before that makes the wait return right away if the submission slipped in between
+		void _sleep() noexcept
 		{
-			switch (policy)
+			u32 epoch = _work_epoch.load(std::memory_order_seq_cst);
+
+			_sleepers.fetch_add(1, std::memory_order_seq_cst);
+
+			if (!_has_work() && !exit.load(std::memory_order_seq_cst))
 			{
-			case kawa::task_schedule_policy::ensure:	
-				return _schedule_ensure(std::forward<task_fn>(task));
-				break;
-			case kawa::task_schedule_policy::wait_if_neccesary:
-				return _schedule_wait_if_necessary(std::forward<task_fn>(task));
-				break;
-			case kawa::task_schedule_policy::try_schedule:
-				return _schedule_try(std::forward<task_fn>(task));
-				break;
-			default:
-				kw_panic();
-				break;
+				_work_epoch.wait(epoch, std::memory_order_seq_cst);
 			}
+
+			_sleepers.fetch_sub(1, std::memory_order_seq_cst);
 		}
 
-		task_handle _schedule_try(task_fn&& task) noexcept
+		bool _has_work() const noexcept
 		{
-			for (u32 i = 0; i < _workers.size(); i++)
+			if (_injected.load(std::memory_order_seq_cst)) return true;
+
+			for (auto w : _workers)
 			{
-				auto& w = *_workers[i];
+				if (!w->deque.empty()) return true;
+			}
+
+			return false;
+		}
+
+		// all policies succeed right away now that deques grow, they are kept for source compatibility
+		task_handle schedule(task_fn&& task, task_schedule_policy = task_schedule_policy::wait_if_neccesary)
+		{
+			task_handle th = _open();
+
+			th.node->fn = std::move(task);
 
-				u32 gen = w.generation.load(std::memory_order_relaxed);
-				if (gen % 2 != 0) continue;
+			_submit(th.node);
 
-				if (w.generation.compare_exchange_strong(gen, gen + 1, std::memory_order_acquire))
+			return th;
+		}
+
+		void _submit(task_node* n)
+		{
+			if (_current_manager == this)
+			{
+				_current_worker->deque.push(n);
+			}
+			else
+			{
+				n->next = _injected.load(std::memory_order_relaxed);
+				while (!_injected.compare_exchange_weak(n->next, n, std::memory_order_seq_cst, std::memory_order_relaxed));
+			}
+
+			_work_epoch.fetch_add(1, std::memory_order_seq_cst);
+
+			if (_sleepers.load(std::memory_order_seq_cst))
+			{
+				_work_epoch.notify_one();
+			}
+		}
+
+		task_node* _find_work(worker_entry& worker) noexcept
+		{
+			if (task_node* n = worker.deque.pop())
+			{
+				return n;
+			}
+
+			// take the whole injection stack over, oldest first, so other workers can steal from it
+			if (task_node* list = _injected.exchange(nullptr, std::memory_order_acquire))
+			{
+				task_node* reversed = nullptr;
+
+				while (list)
 				{
-					w.task = std::forward<task_fn>(task);
+					task_node* next = list->next;
+					list->next = reversed;
+					reversed = list;
+					list = next;
+				}
+
+				task_node* first = reversed;
+				reversed = reversed->next;
+
+				while (reversed)
+				{
+					task_node* next = reversed->next;
+					worker.deque.push(reversed);
+					reversed = next;
+				}
+
+				return first;
+			}
+
+			bool retry = true;
+
+			while (retry)
+			{
+				retry = false;
 
-					w.semaphore.release();
+				for (usize i = 1; i < _workers.size(); i++)
+				{
+					worker_entry& victim = *_workers[(worker.index + i) % _workers.size()];
 
-					return task_handle{ .worker = i, .generation = (gen + 1)};
+					if (task_node* n = victim.deque.steal(retry))
+					{
+						return n;
+					}
 				}
 			}
 
-			return task_handle{ .worker = task_handle::_invalid_worker };
+			return nullptr;
 		}
 
-		task_handle _schedule_ensure(task_fn&& task) noexcept
+		void _run(task_node* n) noexcept
 		{
-			auto th = _schedule_try(std::forward<task_fn>(task));
-			kw_assert(th.worker != task_handle::_invalid_worker);
-			return th;
+			n->fn();
+			n->fn = nullptr;
+
+			_complete(n);
 		}
 
-		task_handle _schedule_wait_if_necessary(task_fn&& task)
+		// a handle that is finished by hand through _finish, lets composite work be waited on like a task
+		task_handle _open()
 		{
-			task_handle out;
+			task_node* n = _pool.acquire();
 
-			while (true)
+			u32 generation = n->generation.fetch_add(1, std::memory_order_relaxed) + 1;
+
+			return task_handle{ .node = n, .generation = generation };
+		}
+
+		void _finish(const task_handle& th) noexcept
+		{
+			kw_assert(!th.done());
+
+			_complete(th.node);
+		}
+
+		void _complete(task_node* n) noexcept
+		{
+			n->generation.fetch_add(1, std::memory_order_seq_cst);
+
+			if (n->parked.load(std::memory_order_seq_cst))
+			{
+				n->generation.notify_all();
+			}
+
+			_resume_waiters(*n);
+
+			_pool.release(n);
+		}
+
+		// whoever takes the list out of node.waiters owns it, so each waiter is resumed exactly once,
+		// either by the thread that finished the task or by the one that pushed it too late
+		static void _push_waiter(task_node& node, task_waiter* waiter) noexcept
+		{
+			// once pushed the waiter may be resumed and gone at any moment
+			u32 generation = waiter->generation;
+
+			waiter->next = node.waiters.load(std::memory_order_relaxed);
+
+			while (!node.waiters.compare_exchange_weak(waiter->next, waiter, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+			if (node.generation.load(std::memory_order_seq_cst) != generation)
 			{
-				out = _schedule_try(std::forward<task_fn>(task));
-				if (out.worker != task_handle::_invalid_worker) return out;
-				std::this_thread::yield();
+				_resume_waiters(node);
 			}
 		}
 
+		static void _resume_waiters(task_node& node) noexcept
+		{
+			task_waiter* list = node.waiters.exchange(nullptr, std::memory_order_seq_cst);
+
+			while (list)
+			{
+				task_waiter* next = list->next;
+
+				if (node.generation.load(std::memory_order_acquire) != list->generation)
+				{
+					list->handle.resume();
+				}
+				else
+				{
+					_push_waiter(node, list);
+				}
+
+				list = next;
+			}
+		}
+
+		usize worker_count() const noexcept
+		{
+			return _workers.size();
+		}
+
+		// runs fn(i) for every i in [begin, end), or fn(chunk_begin, chunk_end) when fn takes a range, the
+		// range goes to a worker as a single task that splits off its upper half whenever its own deque is
+		// empty (lazy binary splitting), so it only fans out while idle workers are around to steal, grain
+		// is the smallest range handed to fn, 0 picks one from the worker count
+		template<typename Fn>
+		task_handle parallel_for(usize begin, usize end, Fn&& fn, usize grain = 0)
+		{
+			if (begin >= end) return {};
+
+			// nothing would ever pick the range up, so the caller runs it
+			if (_workers.empty())
+			{
+				if constexpr (std::is_invocable_v<Fn&, usize, usize>)
+				{
+					fn(begin, end);
+				}
+				else
+				{
+					for (usize i = begin; i < end; i++)
+					{
+						fn(i);
+					}
+				}
+
+				return {};
+			}
+
+			usize count = end - begin;
+
+			if (!grain)
+			{
+				grain = std::max<usize>(1, count / (_workers.size() * 32));
+			}
+
+			auto* state = new _parallel_for_state<std::decay_t<Fn>>{ std::forward<Fn>(fn), this, grain, count, _open() };
+			task_handle done = state->done;
+
+			schedule([state, begin, end]() { state->run(begin, end); });
+
+			return done;
+		}
+
+		template<typename Fn>
+		struct _parallel_for_state
+		{
+			Fn fn;
+			task_manager* tm;
+			usize grain;
+			atomic<usize> remaining;
+			task_handle done;
+
+			void run(usize begin, usize end)
+			{
+				while (begin < end)
+				{
+					while (end - begin > grain && _current_worker->deque.empty())
+					{
+						usize mid = begin + (end - begin) / 2;
+
+						tm->schedule([this, mid, end]() { run(mid, end); });
+
+						end = mid;
+					}
+
+					usize chunk_end = std::min(begin + grain, end);
+
+					if constexpr (std::is_invocable_v<Fn&, usize, usize>)
+					{
+						fn(begin, chunk_end);
+					}
+					else
+					{
+						for (usize i = begin; i < chunk_end; i++)
+						{
+							fn(i);
+						}
+					}
+
+					usize processed = chunk_end - begin;
+					begin = chunk_end;
+
+					if (remaining.fetch_sub(processed, std::memory_order_acq_rel) == processed)
+					{
+						tm->_finish(done);
+						delete this;
+						return;
+					}
+				}
+			}
+		};
+
 		void wait(const task_handle& th) noexcept
 		{
-			if (th.worker == task_handle::_invalid_worker)
-				return;
+			usize spins = 0;
+
+			while (!th.done())
+			{
+				// a worker waiting on its own deque would never see it drained otherwise
+				if (_current_manager == this)
+				{
+					if (task_node* n = _find_work(*_current_worker))
+					{
+						_run(n);
+						continue;
+					}
+				}
 
-			auto& w = *_workers[th.worker];
+				if (spins++ < spin_count)
+				{
+					kw_cpu_relax();
+					continue;
+				}
 
-			while (w.generation.load(std::memory_order_acquire) == th.generation)
+				_park(th);
+			}
+		}
+
+		// only woken by the completion of this very task
+		static void _park(const task_handle& th) noexcept
+		{
+			task_node& n = *th.node;
+
+			n.parked.fetch_add(1, std::memory_order_seq_cst);
+
+			if (n.generation.load(std::memory_order_seq_cst) == th.generation)
 			{
-				std::this_thread::yield();
+				n.generation.wait(th.generation, std::memory_order_seq_cst);
 			}
+
+			n.parked.fetch_sub(1, std::memory_order_seq_cst);
 		}
 
 		void wait(const dyn_array<task_handle>& tasks) noexcept
@@ -152,6 +674,10 @@ namespace kawa
 		}
 
 		dyn_array<worker_entry*> _workers;
+		task_pool _pool;
+		atomic<task_node*> _injected{ nullptr };
+		atomic<u32> _work_epoch{ 0 };
+		atomic<u32> _sleepers{ 0 };
 		atomic<bool> exit;
 	};
 }
@@ -72,6 +72,18 @@ namespace kawa
 			kw_println_colored(kw_ansi_color_cyan, kw_ansi_background_color_default, "### {}/{} ({}%) passsed ###", passed, entries.size(), ((f32)passed / (f32)entries.size()) * 100);
 		}
 
+		usize failed() const noexcept
+		{
+			usize out = 0;
+
+			for (auto& e : entries)
+			{
+				out += !e.result;
+			}
+
+			return out;
+		}
+
 		string name;
 		dyn_array<test_entry> entries;
 	};
@@ -104,6 +116,18 @@ namespace kawa
 			return groups.emplace_back(name);
 		}
 
+		usize failed() const noexcept
+		{
+			usize out = 0;
+
+			for (auto& g : groups)
+			{
+				out += g.failed();
+			}
+
+			return out;
+		}
+
 		dyn_array<test_group> groups;
 		static inline test_manager* _instance = nullptr;
 	};
@@ -122,6 +146,7 @@ namespace kawa
 
 #define kw_tests_print_summary() ::kawa::test_manager::instance()->summary()
 #define kw_tests_rests() ::kawa::test_manager::instance()->groups.clear();
+#define kw_tests_exit_code() (::kawa::test_manager::instance()->failed() ? 1 : 0)
 
 
 #endif // !KAWA_TESTING
@@ -0,0 +1,147 @@
+#include "../kawa/core/ecs.h"
+#include "../kawa/core/testing.h"
+
+using namespace kawa;
+
+struct position { float x, y; };
+struct name { string value; };
+
+struct velocity
+{
+	float dx;
+	double dy;
+};
+
+kw_soa(velocity, dx, dy);
+
+static string name_for(u64 i)
+{
+	return "a name long enough to need its own allocation " + std::to_string(i);
+}
+
+int main()
+{
+	kw_tests_start_group(compact)
+	{
+		kw_test(renumbers_and_keeps_values)
+		{
+			registry reg({ .max_entity_count = 1024 });
+
+			// the original index of every entity is stored in it so values can be checked after the move
+			for (u64 i = 0; i < 1000; i++)
+			{
+				entity_id e = reg.entity(position{ (float)i, 0.0f });
+
+				if (i % 2) reg.emplace<name>(e, name_for(i));
+				if (i % 3) reg.emplace<velocity>(e, velocity{ (float)i, i * 2.0 });
+			}
+
+			for (u64 i = 0; i < 1000; i++)
+			{
+				if (i % 5 == 0 || (i > 600 && i < 700)) reg.destroy(i);
+			}
+
+			dyn_array<pair<u64, u64>> expected;
+			u64 next = 0;
+
+			for (u64 i = 0; i < 1000; i++)
+			{
+				if (i % 5 == 0 || (i > 600 && i < 700)) continue;
+
+				if (next != i) expected.emplace_back(i, next);
+
+				next++;
+			}
+
+			usize live = reg.entity_count();
+			dyn_array<pair<u64, u64>> remapped;
+
+			reg.compact([&](entity_id from, entity_id to) { remapped.emplace_back((u64)from, (u64)to); });
+
+			kw_test_require(remapped == expected);
+			kw_test_require(reg.entity_count() == live);
+
+			umap<u64, u64> original;
+
+			for (u64 i = 0, to = 0; i < 1000; i++)
+			{
+				if (i % 5 == 0 || (i > 600 && i < 700)) continue;
+
+				original[to++] = i;
+			}
+
+			bool values = true;
+			usize visited = 0;
+
+			reg.query(
+				[&](entity_id e, position& p, name* n)
+				{
+					u64 i = original.at(e);
+					visited++;
+
+					values &= p.x == (float)i;
+					values &= (n != nullptr) == (i % 2 == 1) && (!n || n->value == name_for(i));
+					values &= reg.has<velocity>(e) == (i % 3 != 0);
+				}
+			);
+
+			reg.query(
+				[&](entity_id e, soa<velocity> v)
+				{
+					u64 i = original.at(e);
+					values &= v.dx == (float)i && v.dy == i * 2.0;
+				}
+			);
+
+			kw_test_require(values);
+			kw_test_require(visited == live);
+
+			// fresh ids continue right after the compacted range, nothing of the old free list is left
+			entity_id a = reg.entity(name{ "a" });
+			entity_id b = reg.entity();
+
+			kw_test_require((u64)a == live);
+			kw_test_require((u64)b == live + 1);
+			kw_test_require(!reg.has<position>(a) && reg.get<name>(a).value == "a");
+		};
+
+		kw_test(already_dense)
+		{
+			registry reg({ .max_entity_count = 16 });
+
+			for (int i = 0; i < 10; i++)
+			{
+				reg.entity(position{ (float)i, 0.0f });
+			}
+
+			usize calls = 0;
+			reg.compact([&](entity_id, entity_id) { calls++; });
+
+			kw_test_require(calls == 0);
+			kw_test_require((u64)reg.entity() == 10);
+		};
+
+		kw_test(batch_events_use_old_ids)
+		{
+			registry reg({ .max_entity_count = 16 });
+			dyn_array<entity_id> destroyed;
+
+			reg.on_destruct_batch<position>([&](span<const entity_id> ids) { destroyed.insert(destroyed.end(), ids.begin(), ids.end()); });
+
+			for (int i = 0; i < 10; i++)
+			{
+				reg.entity(position{ (float)i, 0.0f });
+			}
+
+			reg.destroy(2);
+			reg.destroy(7);
+			reg.compact();
+
+			kw_test_require(destroyed == dyn_array<entity_id>({ 2, 7 }));
+			kw_test_require(reg.get<position>(6).x == 8.0f);
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
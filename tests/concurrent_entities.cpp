@@ -0,0 +1,118 @@
+#include "../kawa/core/ecs.h"
+#include "../kawa/core/testing.h"
+
+using namespace kawa;
+
+struct position { float x, y; };
+struct parent { u64 id; };
+struct tag { int value; };
+
+int main()
+{
+	kw_tests_start_group(concurrent_entities)
+	{
+		kw_test(entity_concurrent_from_threads)
+		{
+			registry reg({ .max_entity_count = 40000 });
+
+			// freed ids are handed out again before fresh ones
+			for (int i = 0; i < 10000; i++)
+			{
+				reg.entity(position{ (float)i, 0.0f });
+			}
+
+			for (u64 i = 0; i < 10000; i += 5)
+			{
+				reg.destroy(i);
+			}
+
+			reg.prepare<position, parent>();
+
+			constexpr usize thread_count = 4;
+			constexpr usize per_thread = 5000;
+
+			dyn_array<thread> threads;
+
+			for (usize t = 0; t < thread_count; t++)
+			{
+				threads.emplace_back(
+					[&reg, t]()
+					{
+						for (usize i = 0; i < per_thread; i++)
+						{
+							reg.entity_concurrent(position{ -1.0f, (float)t }, parent{ t });
+						}
+					}
+				);
+			}
+
+			for (auto& t : threads)
+			{
+				t.join();
+			}
+
+			uset<u64> seen;
+			usize created = 0;
+			bool unique = true;
+			bool complete = true;
+
+			reg.query(
+				[&](entity_id e, position& p, parent& par)
+				{
+					created++;
+					unique &= seen.insert(e).second;
+					complete &= p.x == -1.0f && (u64)p.y == par.id;
+				}
+			);
+
+			kw_test_require(created == thread_count * per_thread);
+			kw_test_require(unique);
+			kw_test_require(complete);
+			kw_test_require(reg.entity_count() == 8000 + thread_count * per_thread);
+		};
+
+		kw_test(emplace_concurrent_from_query_par)
+		{
+			registry reg({ .max_entity_count = 20000 });
+			task_manager tm(4);
+
+			for (int i = 0; i < 20000; i++)
+			{
+				reg.entity(position{ (float)i, 0.0f });
+			}
+
+			reg.prepare<tag>();
+
+			dyn_array<task_handle> handles;
+
+			reg.query_par(tm, task_schedule_policy::wait_if_neccesary, 8, handles,
+				[&reg](entity_id e, position& p)
+				{
+					if ((u64)e % 3 == 0)
+					{
+						reg.emplace_concurrent<tag>(e, (int)p.x);
+					}
+				}
+			);
+
+			tm.wait(handles);
+
+			usize tagged = 0;
+			bool matches = true;
+
+			reg.query(
+				[&](entity_id e, const position& p, const tag& t)
+				{
+					tagged++;
+					matches &= (u64)e % 3 == 0 && t.value == (int)p.x;
+				}
+			);
+
+			kw_test_require(tagged == 6667);
+			kw_test_require(matches);
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
@@ -0,0 +1,136 @@
+#include "../kawa/core/coroutine.h"
+#include "../kawa/core/testing.h"
+
+#include <stdexcept>
+
+using namespace kawa;
+
+static task<int> sum_in_parallel(task_manager& tm, dyn_array<int>& values)
+{
+	dyn_array<task_handle> handles;
+
+	for (usize i = 0; i < values.size(); i++)
+	{
+		handles.push_back(tm.schedule([&values, i]() { values[i] = (int)i; }));
+	}
+
+	co_await when_all(std::move(handles));
+
+	int out = 0;
+
+	for (int v : values)
+	{
+		out += v;
+	}
+
+	co_return out;
+}
+
+static task<int> chained(task_manager& tm, atomic<int>& ran_on_worker)
+{
+	co_await resume_on(tm);
+
+	ran_on_worker += _current_manager == &tm;
+
+	task_handle th = tm.schedule([]() { std::this_thread::sleep_for(std::chrono::milliseconds(5)); });
+	co_await when_done(th);
+
+	co_return 7;
+}
+
+static task<void> throws()
+{
+	throw std::runtime_error("boom");
+	co_return;
+}
+
+int main()
+{
+	kw_tests_start_group(coroutine)
+	{
+		kw_test(sync_wait_when_all)
+		{
+			task_manager tm(4);
+			bool all = true;
+
+			for (int round = 0; round < 100; round++)
+			{
+				dyn_array<int> values(64, -1);
+				all &= sync_wait(sum_in_parallel(tm, values)) == 63 * 64 / 2;
+			}
+
+			kw_test_require(all);
+		};
+
+		kw_test(when_all_of_finished_handles)
+		{
+			task_manager tm(2);
+
+			dyn_array<task_handle> handles = { tm.schedule([]() {}), tm.schedule([]() {}) };
+			tm.wait(handles);
+
+			sync_wait(when_all(handles));
+
+			kw_test_require(handles[0].done() && handles[1].done());
+		};
+
+		kw_test(resume_on_and_when_done)
+		{
+			task_manager tm(2);
+			atomic<int> ran_on_worker{ 0 };
+
+			int total = 0;
+
+			for (int round = 0; round < 20; round++)
+			{
+				total += sync_wait(chained(tm, ran_on_worker));
+			}
+
+			kw_test_require(total == 140);
+			kw_test_require(ran_on_worker.load() == 20);
+		};
+
+		kw_test(exceptions_reach_sync_wait)
+		{
+			bool caught = false;
+
+			try
+			{
+				sync_wait(throws());
+			}
+			catch (const std::runtime_error&)
+			{
+				caught = true;
+			}
+
+			kw_test_require(caught);
+		};
+
+		kw_test(spawn)
+		{
+			task_manager tm(2);
+			atomic<int> finished{ 0 };
+
+			for (int i = 0; i < 50; i++)
+			{
+				spawn(tm,
+					[](task_manager& tm, atomic<int>& finished) -> task<void>
+					{
+						co_await when_done(tm.schedule([]() {}));
+						finished++;
+					}(tm, finished)
+				);
+			}
+
+			while (finished.load() < 50)
+			{
+				std::this_thread::yield();
+			}
+
+			kw_test_require(finished.load() == 50);
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
@@ -0,0 +1,141 @@
+#include "../kawa/core/ecs.h"
+#include "../kawa/core/testing.h"
+
+#include <random>
+
+using namespace kawa;
+
+struct position
+{
+	float x, y;
+	bool operator==(const position&) const = default;
+};
+
+struct health
+{
+	int hp;
+	bool operator==(const health&) const = default;
+};
+
+static bool same_contents(registry& a, registry& b)
+{
+	if (a.entity_count() != b.entity_count()) return false;
+
+	bool same = true;
+	usize with_position = 0;
+	usize with_health = 0;
+
+	a.query(
+		[&](entity_id e, position* p, health* h)
+		{
+			position* q = b.try_get<position>(e);
+			health* g = b.try_get<health>(e);
+
+			same &= (p == nullptr) == (q == nullptr) && (!p || *p == *q);
+			same &= (h == nullptr) == (g == nullptr) && (!h || *h == *g);
+		}
+	);
+
+	b.query([&](position&) { with_position++; });
+	b.query([&](health&) { with_health++; });
+
+	usize expected_position = 0;
+	usize expected_health = 0;
+
+	a.query([&](position&) { expected_position++; });
+	a.query([&](health&) { expected_health++; });
+
+	return same && with_position == expected_position && with_health == expected_health;
+}
+
+int main()
+{
+	kw_tests_start_group(diff)
+	{
+		kw_test(round_trip)
+		{
+			registry source({ .max_entity_count = 2048 });
+			registry previous({ .max_entity_count = 2048 });
+			registry replica({ .max_entity_count = 2048 });
+
+			std::mt19937 rng(7);
+			dyn_array<entity_id> live;
+			bool in_sync = true;
+
+			for (int tick = 0; tick < 50; tick++)
+			{
+				for (int k = 0; k < 30; k++)
+				{
+					u32 op = rng() % 5;
+
+					if (op == 0 || live.empty())
+					{
+						live.push_back(source.entity(position{ (float)k, 1.0f }));
+						continue;
+					}
+
+					usize i = rng() % live.size();
+					entity_id e = live[i];
+
+					if (op == 1)
+					{
+						source.destroy(e);
+						live.erase(live.begin() + i);
+					}
+					else if (op == 2)
+					{
+						source.emplace<health>(e, (int)rng());
+					}
+					else if (op == 3)
+					{
+						source.erase<position>(e);
+					}
+					else if (source.has<position>(e))
+					{
+						source.get<position>(e).x += 1.0f;
+					}
+				}
+
+				dyn_array<u8> data;
+				source.diff(previous, data);
+
+				previous.apply_diff<position, health>(data);
+				replica.apply_diff<position, health>(data);
+
+				in_sync &= same_contents(source, replica) && same_contents(source, previous);
+			}
+
+			// ids handed out after catching up have to match, which needs the free list in sync too
+			entity_id a = source.entity();
+			entity_id b = replica.entity();
+
+			kw_test_require(in_sync);
+			kw_test_require(a == b);
+		};
+
+		kw_test(no_changes_is_small)
+		{
+			registry source({ .max_entity_count = 256 });
+
+			for (int i = 0; i < 100; i++)
+			{
+				source.entity(position{ (float)i, 0.0f }, health{ i });
+			}
+
+			registry replica({ .max_entity_count = 256 });
+
+			dyn_array<u8> first;
+			source.diff(replica, first);
+			replica.apply_diff<position, health>(first);
+
+			dyn_array<u8> second;
+			source.diff(replica, second);
+
+			kw_test_require(same_contents(source, replica));
+			kw_test_require(second.size() < first.size() / 10);
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
@@ -0,0 +1,70 @@
+#include "../kawa/core/ecs.h"
+#include "../kawa/core/testing.h"
+
+using namespace kawa;
+
+struct hit { u64 from; };
+
+int main()
+{
+	kw_tests_start_group(event_channel)
+	{
+		kw_test(short_lived_threads_reuse_slots)
+		{
+			event_channel<hit> channel;
+
+			// more threads than there are writer slots, only one is alive at a time
+			constexpr usize thread_count = kw_max_event_writers + 16;
+
+			for (usize i = 0; i < thread_count; i++)
+			{
+				thread([&channel, i]() { channel.send(hit{ i }); }).join();
+			}
+
+			channel.swap();
+
+			u64 sum = 0;
+			channel.read([&](const hit& h) { sum += h.from; });
+
+			kw_test_require(channel.size() == thread_count);
+			kw_test_require(sum == thread_count * (thread_count - 1) / 2);
+		};
+
+		kw_test(recreated_task_managers)
+		{
+			registry reg({ .max_entity_count = 1024 });
+
+			for (int i = 0; i < 1024; i++)
+			{
+				reg.entity(hit{ (u64)i });
+			}
+
+			// channels are created lazily, that part isn't safe to race
+			event_channel<hit>& hits = reg.events<hit>();
+			bool all = true;
+
+			for (int round = 0; round < 40; round++)
+			{
+				task_manager tm(4);
+				dyn_array<task_handle> handles;
+
+				reg.query_par(tm, task_schedule_policy::wait_if_neccesary, 8, handles,
+					[&hits](const hit& h)
+					{
+						hits.send(h);
+					}
+				);
+
+				tm.wait(handles);
+				reg.swap_events();
+
+				all &= hits.size() == 1024;
+			}
+
+			kw_test_require(all);
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
@@ -0,0 +1,121 @@
+#include "../kawa/core/fast_map.h"
+#include "../kawa/core/testing.h"
+
+#include <random>
+
+using namespace kawa;
+
+static bool matches(const hash_map<string>& map, const umap<u64, string>& reference)
+{
+	if (map.size() != reference.size()) return false;
+
+	for (auto& [key, value] : reference)
+	{
+		const string* found = map.try_get(key);
+
+		if (!found || *found != value) return false;
+	}
+
+	usize visited = 0;
+
+	for (auto& s : map)
+	{
+		auto it = reference.find(s.key);
+
+		if (it == reference.end() || it->second != s.value) return false;
+
+		visited++;
+	}
+
+	return visited == reference.size();
+}
+
+int main()
+{
+	kw_tests_start_group(hash_map)
+	{
+		kw_test(insert_erase_churn)
+		{
+			hash_map<string> map({ .capacity = 4 });
+			umap<u64, string> reference;
+
+			std::mt19937_64 rng(11);
+			bool consistent = true;
+
+			for (usize round = 0; round < 20000; round++)
+			{
+				// a small key space keeps clusters dense so erase has to shift entries back often
+				u64 key = rng() % 512;
+
+				if (rng() % 3)
+				{
+					string value = std::to_string(round) + " with a tail long enough to leave the small string buffer";
+
+					map.insert(key, value);
+					reference[key] = value;
+				}
+				else
+				{
+					map.erase(key);
+					reference.erase(key);
+				}
+
+				if (round % 997 == 0)
+				{
+					consistent &= matches(map, reference);
+				}
+			}
+
+			kw_test_require(consistent);
+			kw_test_require(matches(map, reference));
+		};
+
+		kw_test(colliding_low_bits)
+		{
+			hash_map<string> map;
+			umap<u64, string> reference;
+
+			for (u64 i = 0; i < 4096; i++)
+			{
+				u64 key = i << 40;
+				map.insert(key, std::to_string(i));
+				reference[key] = std::to_string(i);
+			}
+
+			for (u64 i = 0; i < 4096; i += 2)
+			{
+				map.erase(i << 40);
+				reference.erase(i << 40);
+			}
+
+			kw_test_require(matches(map, reference));
+			kw_test_require(!map.contains(u64(2) << 40));
+			kw_test_require(map.get(u64(3) << 40) == "3");
+		};
+
+		kw_test(copy_and_clear)
+		{
+			hash_map<string> map;
+
+			for (u64 i = 0; i < 300; i++)
+			{
+				map.insert(i * 31, std::to_string(i));
+			}
+
+			hash_map<string> copy(map);
+			map.clear();
+
+			kw_test_require(map.empty());
+			kw_test_require(copy.size() == 300);
+			kw_test_require(copy.get(31 * 299) == "299");
+
+			map = std::move(copy);
+
+			kw_test_require(map.size() == 300);
+			kw_test_require(map.get(0) == "0");
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
@@ -0,0 +1,154 @@
+#include "../kawa/core/ecs.h"
+#include "../kawa/core/testing.h"
+
+using namespace kawa;
+
+struct health { int hp; };
+struct marker { int value; };
+
+int main()
+{
+	kw_tests_start_group(lifetime_listeners)
+	{
+		kw_test(several_listeners_in_order)
+		{
+			registry reg({ .max_entity_count = 64 });
+			dyn_array<int> calls;
+
+			reg.on_construct([&](entity_id, health&) { calls.push_back(1); });
+			usize second = reg.on_construct([&](entity_id, health&) { calls.push_back(2); });
+			reg.on_construct([&](entity_id, health& h) { calls.push_back(h.hp); });
+
+			reg.entity(health{ 3 });
+			reg.remove_on_construct<health>(second);
+			reg.entity(health{ 4 });
+
+			kw_test_require(calls == dyn_array<int>({ 1, 2, 3, 1, 4 }));
+			kw_test_require(reg.remove_on_construct<health>(second) == false);
+		};
+
+		kw_test(disconnect_self_during_dispatch)
+		{
+			registry reg({ .max_entity_count = 64 });
+			usize self = 0;
+			int once = 0;
+			int always = 0;
+
+			self = reg.on_construct([&](entity_id, health&) { once++; reg.remove_on_construct<health>(self); });
+			reg.on_construct([&](entity_id, health&) { always++; });
+
+			for (int i = 0; i < 5; i++)
+			{
+				reg.entity(health{ i });
+			}
+
+			kw_test_require(once == 1);
+			kw_test_require(always == 5);
+		};
+
+		kw_test(disconnect_other_during_dispatch)
+		{
+			registry reg({ .max_entity_count = 64 });
+			usize victim = 0;
+			int victim_calls = 0;
+
+			reg.on_construct([&](entity_id, health&) { reg.remove_on_construct<health>(victim); });
+			victim = reg.on_construct([&](entity_id, health&) { victim_calls++; });
+
+			reg.entity(health{ 1 });
+			reg.entity(health{ 2 });
+
+			// removed before its turn, so it never runs
+			kw_test_require(victim_calls == 0);
+		};
+
+		kw_test(connect_during_dispatch)
+		{
+			registry reg({ .max_entity_count = 64 });
+			int added_calls = 0;
+			bool connected = false;
+
+			reg.on_construct(
+				[&](entity_id, health&)
+				{
+					if (connected) return;
+
+					connected = true;
+
+					// enough new listeners to grow the list several times over
+					for (int i = 0; i < 32; i++)
+					{
+						reg.on_construct([&](entity_id, health&) { added_calls++; });
+					}
+				}
+			);
+
+			reg.entity(health{ 1 });
+			int after_first = added_calls;
+			reg.entity(health{ 2 });
+
+			kw_test_require(after_first == 0);
+			kw_test_require(added_calls == 32);
+		};
+
+		kw_test(nested_dispatch)
+		{
+			registry reg({ .max_entity_count = 64 });
+			usize self = 0;
+			int outer = 0;
+			int inner = 0;
+
+			self = reg.on_construct(
+				[&](entity_id, health& h)
+				{
+					outer++;
+
+					if (h.hp == 0)
+					{
+						// raises the same signal again while this listener is still running
+						reg.entity(health{ 1 });
+						reg.remove_on_construct<health>(self);
+						reg.on_construct([&](entity_id, health&) { inner++; });
+					}
+				}
+			);
+
+			reg.entity(health{ 0 });
+			reg.entity(health{ 2 });
+
+			kw_test_require(outer == 2);
+			kw_test_require(inner == 1);
+			kw_test_require(reg.entity_count() == 3);
+		};
+
+		kw_test(batch_listeners_during_flush)
+		{
+			registry reg({ .max_entity_count = 64 });
+			usize self = 0;
+			usize first_batch = 0;
+			usize later_batches = 0;
+
+			self = reg.on_construct_batch<marker>(
+				[&](span<const entity_id> ids)
+				{
+					first_batch += ids.size();
+					reg.remove_on_construct<marker>(self);
+					reg.on_construct_batch<marker>([&](span<const entity_id> more) { later_batches += more.size(); });
+				}
+			);
+
+			reg.entity(marker{ 1 });
+			reg.entity(marker{ 2 });
+			reg.flush_events();
+
+			reg.entity(marker{ 3 });
+			reg.flush_events();
+
+			kw_test_require(first_batch == 2);
+			kw_test_require(later_batches == 1);
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
@@ -0,0 +1,89 @@
+#include "../kawa/core/ecs.h"
+#include "../kawa/core/testing.h"
+
+using namespace kawa;
+
+struct position { float x, y; };
+struct name { string value; };
+
+// forwards to the default resource and remembers what is still outstanding
+struct tracking_resource : memory_resource
+{
+	void* do_allocate(usize bytes, usize alignment) override
+	{
+		outstanding += bytes;
+		allocations++;
+		storage_objects += bytes == sizeof(component_storage);
+		return default_memory_resource()->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* ptr, usize bytes, usize alignment) override
+	{
+		outstanding -= bytes;
+		default_memory_resource()->deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+	usize outstanding = 0;
+	usize allocations = 0;
+	usize storage_objects = 0;
+};
+
+int main()
+{
+	kw_tests_start_group(memory_resource)
+	{
+		kw_test(registry_allocations_come_from_the_resource)
+		{
+			tracking_resource resource;
+
+			{
+				registry reg({ .max_entity_count = 256, .resource = &resource });
+
+				for (int i = 0; i < 100; i++)
+				{
+					reg.entity(position{ (float)i, 0.0f }, name{ "a name long enough to allocate its own buffer" });
+				}
+
+				kw_test_require(resource.storage_objects == 2);
+				kw_test_require(resource.outstanding > 0);
+			}
+
+			kw_test_require(resource.outstanding == 0);
+		};
+
+		kw_test(copies_follow_the_source_resource)
+		{
+			tracking_resource first;
+			tracking_resource second;
+
+			{
+				registry source({ .max_entity_count = 64, .resource = &first });
+				source.entity(position{ 1.0f, 2.0f });
+
+				registry target({ .max_entity_count = 64, .resource = &second });
+				target.entity(name{ "replaced" });
+
+				usize before = first.storage_objects;
+				target = source;
+
+				kw_test_require(first.storage_objects == before + 1);
+				kw_test_require(target.get<position>(0).y == 2.0f);
+
+				registry moved = std::move(target);
+
+				kw_test_require(moved.get<position>(0).x == 1.0f);
+			}
+
+			kw_test_require(first.outstanding == 0);
+			kw_test_require(second.outstanding == 0);
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
@@ -0,0 +1,90 @@
+#include "../kawa/core/ecs.h"
+#include "../kawa/core/testing.h"
+
+using namespace kawa;
+
+struct position { float x, y; };
+struct name { string value; };
+struct only_in_source { int value; };
+
+int main()
+{
+	kw_tests_start_group(migrate)
+	{
+		kw_test(moves_components_and_maps_ids)
+		{
+			registry source({ .max_entity_count = 256 });
+			registry target({ .max_entity_count = 256 });
+
+			// target already uses some ids and has a position storage but no name or only_in_source storage
+			target.entity(position{ -1.0f, -1.0f });
+			target.entity(position{ -2.0f, -2.0f });
+
+			dyn_array<entity_id> moved;
+			dyn_array<entity_id> kept;
+
+			for (int i = 0; i < 40; i++)
+			{
+				entity_id e = source.entity(position{ (float)i, (float)-i });
+
+				if (i % 2) source.emplace<name>(e, "entity with a name long enough to live on the heap " + std::to_string(i));
+				if (i % 5 == 0) source.emplace<only_in_source>(e, i);
+
+				(i % 3 ? moved : kept).push_back(e);
+			}
+
+			dyn_array<entity_id> mapped = source.migrate(target, moved);
+
+			bool values = mapped.size() == moved.size();
+
+			for (usize k = 0; k < moved.size() && values; k++)
+			{
+				int i = (int)(u64)moved[k];
+				entity_id e = mapped[k];
+
+				values &= target.get<position>(e).x == (float)i && target.get<position>(e).y == (float)-i;
+				values &= target.has<name>(e) == (i % 2 == 1);
+				values &= !(i % 2) || target.get<name>(e).value == "entity with a name long enough to live on the heap " + std::to_string(i);
+				values &= target.has<only_in_source>(e) == (i % 5 == 0);
+				values &= (i % 5) || target.get<only_in_source>(e).value == i;
+				values &= !source.has<position>(moved[k]) && !source.has<name>(moved[k]);
+			}
+
+			bool kept_intact = true;
+
+			for (entity_id e : kept)
+			{
+				kept_intact &= source.get<position>(e).x == (float)(u64)e;
+			}
+
+			kw_test_require(values);
+			kw_test_require(kept_intact);
+			kw_test_require(source.entity_count() == kept.size());
+			kw_test_require(target.entity_count() == 2 + moved.size());
+			kw_test_require(target.get<position>(0).x == -1.0f);
+		};
+
+		kw_test(repeated_ids)
+		{
+			registry source({ .max_entity_count = 16 });
+			registry target({ .max_entity_count = 16 });
+
+			entity_id a = source.entity(name{ "a" });
+			entity_id b = source.entity(name{ "b" });
+
+			dyn_array<entity_id> ids = { a, b, a, a };
+			dyn_array<entity_id> mapped = source.migrate(target, ids);
+
+			kw_test_require(mapped.size() == 4);
+			kw_test_require(mapped[0] == mapped[2] && mapped[0] == mapped[3]);
+			kw_test_require(mapped[0] != mapped[1]);
+			kw_test_require(target.entity_count() == 2);
+			kw_test_require(source.entity_count() == 0);
+			kw_test_require(target.get<name>(mapped[0]).value == "a");
+			kw_test_require(target.get<name>(mapped[1]).value == "b");
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
@@ -0,0 +1,52 @@
+#include "../kawa/core/task_manager.h"
+#include "../kawa/core/testing.h"
+
+using namespace kawa;
+
+int main()
+{
+	kw_tests_start_group(parallel_for)
+	{
+		kw_test(every_index_once)
+		{
+			task_manager tm(4);
+			dyn_array<atomic<u32>> visits(100000);
+
+			tm.wait(tm.parallel_for(0, visits.size(), [&](usize i) { visits[i]++; }));
+
+			bool once = true;
+
+			for (auto& v : visits)
+			{
+				once &= v.load() == 1;
+			}
+
+			kw_test_require(once);
+		};
+
+		kw_test(ranges)
+		{
+			task_manager tm(3);
+			atomic<usize> total{ 0 };
+
+			tm.wait(tm.parallel_for(10, 5010, [&](usize b, usize e) { total += e - b; }, 7));
+
+			kw_test_require(total.load() == 5000);
+		};
+
+		kw_test(no_workers)
+		{
+			task_manager tm(0);
+			usize sum = 0;
+
+			task_handle th = tm.parallel_for(0, 100, [&](usize i) { sum += i; });
+			tm.wait(th);
+
+			kw_test_require(th.done());
+			kw_test_require(sum == 4950);
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
@@ -0,0 +1,120 @@
+#include "../kawa/core/ecs.h"
+#include "../kawa/core/testing.h"
+
+using namespace kawa;
+
+struct health { int hp; };
+struct armor { int value; };
+
+static void populate(registry& reg)
+{
+	for (int i = 0; i < 5000; i++)
+	{
+		entity_id e = reg.entity(health{ i % 97 });
+
+		if (i % 3 == 0) reg.emplace<armor>(e, i);
+	}
+
+	for (u64 i = 0; i < 5000; i += 11)
+	{
+		reg.destroy(i);
+	}
+}
+
+int main()
+{
+	kw_tests_start_group(query_par_reduce)
+	{
+		kw_test(matches_serial_fold)
+		{
+			registry reg({ .max_entity_count = 5000 });
+			populate(reg);
+
+			i64 serial_sum = 0;
+			dyn_array<u64> serial_order;
+
+			reg.query([&](entity_id e, const health& h, const armor& a) { serial_sum += h.hp * (i64)a.value; serial_order.push_back(e); });
+
+			bool all = true;
+
+			for (usize workers : { 0, 1, 2, 7 })
+			{
+				task_manager tm(workers);
+
+				i64 sum = reg.query_par_reduce(tm, i64(0),
+					[](const health& h, const armor& a) { return h.hp * (i64)a.value; },
+					[](i64 acc, i64 v) { return acc + v; }
+				);
+
+				// group results are combined in group order, so an order sensitive fold agrees as well
+				dyn_array<u64> order = reg.query_par_reduce(tm, dyn_array<u64>{},
+					[](entity_id e, const health&, const armor&) { return (u64)e; },
+					[](dyn_array<u64> acc, auto&& next)
+					{
+						// slots are folded entity by entity, the group results are then folded into each other
+						if constexpr (std::is_same_v<std::remove_cvref_t<decltype(next)>, u64>)
+						{
+							acc.push_back(next);
+						}
+						else
+						{
+							acc.insert(acc.end(), next.begin(), next.end());
+						}
+
+						return acc;
+					}
+				);
+
+				usize count = reg.query_par_reduce(tm, usize(0),
+					[](const health&) { return usize(1); },
+					[](usize acc, usize v) { return acc + v; }
+				);
+
+				all &= sum == serial_sum;
+				all &= order == serial_order;
+				all &= count == reg.entity_count();
+			}
+
+			kw_test_require(all);
+		};
+
+		kw_test(empty_query)
+		{
+			registry reg({ .max_entity_count = 16 });
+
+			for (usize workers : { 0, 3 })
+			{
+				task_manager tm(workers);
+
+				int sum = reg.query_par_reduce(tm, 0,
+					[](const health& h) { return h.hp; },
+					[](int acc, int v) { return acc + v; }
+				);
+
+				kw_test_require(sum == 0);
+			}
+		};
+
+		kw_test(query_par_without_workers)
+		{
+			registry reg({ .max_entity_count = 5000 });
+			populate(reg);
+
+			task_manager tm(0);
+			dyn_array<task_handle> handles;
+			usize visited = 0;
+
+			reg.query_par(tm, task_schedule_policy::wait_if_neccesary, 4, handles, [&](health& h) { h.hp = -1; visited++; });
+			tm.wait(handles);
+
+			usize reset = 0;
+			reg.query([&](const health& h) { reset += h.hp == -1; });
+
+			kw_test_require(visited == reg.entity_count());
+			kw_test_require(reset == reg.entity_count());
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
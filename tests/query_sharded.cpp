@@ -0,0 +1,95 @@
+#include "../kawa/core/ecs.h"
+#include "../kawa/core/testing.h"
+
+using namespace kawa;
+
+struct health { int hp; };
+struct offspring { u64 parent; int generation; };
+
+using snapshot_t = map<u64, tuple<int, bool, u64, int>>;
+
+static snapshot_t run_workload(usize workers)
+{
+	registry reg({ .max_entity_count = 8192 });
+	task_manager tm(workers);
+
+	for (int i = 0; i < 1500; i++)
+	{
+		reg.entity(health{ (i * 37) % 101 });
+	}
+
+	for (int frame = 0; frame < 8; frame++)
+	{
+		// destroyed ids go to the free list and clones pick them up again, so the
+		// resulting ids depend on the exact order the shard buffers are flushed in
+		reg.query_sharded(tm, 16,
+			[frame](entity_id e, health& h, registry::defer_buffer& buffer)
+			{
+				h.hp = (h.hp * 13 + frame) % 101;
+
+				if (h.hp < 20)
+				{
+					buffer.destroy(e);
+				}
+				else if (h.hp > 85)
+				{
+					buffer.clone(e);
+					buffer.emplace<offspring>(e, (u64)e, frame);
+				}
+				else if (h.hp % 7 == 0)
+				{
+					buffer.erase<offspring>(e);
+				}
+			}
+		);
+	}
+
+	snapshot_t out;
+
+	reg.query(
+		[&](entity_id e, const health& h, const offspring* o)
+		{
+			out[e] = { h.hp, o != nullptr, o ? o->parent : 0, o ? o->generation : -1 };
+		}
+	);
+
+	return out;
+}
+
+int main()
+{
+	kw_tests_start_group(query_sharded)
+	{
+		kw_test(same_result_for_any_worker_count)
+		{
+			snapshot_t reference = run_workload(1);
+
+			bool same = true;
+
+			for (usize workers : { 0, 2, 4, 7 })
+			{
+				same &= run_workload(workers) == reference;
+			}
+
+			kw_test_require(reference.size() > 1000);
+			kw_test_require(same);
+		};
+
+		kw_test(repeated_runs_agree)
+		{
+			snapshot_t first = run_workload(4);
+
+			bool same = true;
+
+			for (int i = 0; i < 5; i++)
+			{
+				same &= run_workload(4) == first;
+			}
+
+			kw_test_require(same);
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
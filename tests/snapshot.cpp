@@ -0,0 +1,98 @@
+#include "../kawa/core/ecs.h"
+#include "../kawa/core/testing.h"
+
+#include <filesystem>
+
+using namespace kawa;
+
+struct position { float x, y; };
+struct health { int hp; };
+
+int main()
+{
+	string path = (std::filesystem::temp_directory_path() / "kawa_snapshot_test.bin").string();
+
+	kw_tests_start_group(snapshot)
+	{
+		kw_test(round_trip)
+		{
+			dyn_array<entity_id> ids;
+
+			{
+				registry reg({ .max_entity_count = 1024 });
+
+				for (int i = 0; i < 600; i++)
+				{
+					entity_id e = reg.entity(position{ (float)i, (float)-i });
+
+					if (i % 3 == 0)
+					{
+						reg.emplace<health>(e, i);
+					}
+
+					ids.push_back(e);
+				}
+
+				for (usize i = 0; i < ids.size(); i += 7)
+				{
+					reg.destroy(ids[i]);
+				}
+
+				reg.save_snapshot(path);
+			}
+
+			registry loaded({ .max_entity_count = 1024 });
+			loaded.load_snapshot<position, health>(path);
+
+			bool intact = true;
+			usize alive = 0;
+
+			for (usize i = 0; i < ids.size(); i++)
+			{
+				bool destroyed = i % 7 == 0;
+
+				if (loaded.has<position>(ids[i]) == destroyed)
+				{
+					intact = false;
+					continue;
+				}
+
+				if (destroyed) continue;
+
+				alive++;
+				intact &= loaded.get<position>(ids[i]).x == (float)i;
+				intact &= loaded.has<health>(ids[i]) == (i % 3 == 0);
+
+				if (i % 3 == 0)
+				{
+					intact &= loaded.get<health>(ids[i]).hp == (int)i;
+				}
+			}
+
+			kw_test_require(intact);
+			kw_test_require(loaded.entity_count() == alive);
+		};
+
+		kw_test(mutate_after_load)
+		{
+			registry loaded({ .max_entity_count = 1024 });
+			loaded.load_snapshot<position, health>(path);
+
+			usize before = loaded.entity_count();
+
+			loaded.query([](position& p) { p.x += 1.0f; });
+
+			entity_id e = loaded.entity(position{ 1.0f, 2.0f }, health{ 5 });
+			registry copy(loaded);
+
+			kw_test_require(loaded.entity_count() == before + 1);
+			kw_test_require(copy.get<health>(e).hp == 5);
+			kw_test_require(copy.get<position>(e).y == 2.0f);
+		};
+	};
+
+	std::filesystem::remove(path);
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
@@ -0,0 +1,241 @@
+#include "../kawa/core/ecs.h"
+#include "../kawa/core/testing.h"
+
+#include <filesystem>
+
+using namespace kawa;
+
+// mixed field sizes so the field arrays get reordered by alignment
+struct particle
+{
+	float x;
+	double mass;
+	u8 flags;
+	u16 group;
+};
+
+kw_soa(particle, x, mass, flags, group);
+
+struct tag { int value; };
+
+static particle make_particle(usize i)
+{
+	return particle{ (float)i, i * 0.5, (u8)(i % 7), (u16)(i * 3) };
+}
+
+static bool same(const particle& p, usize i)
+{
+	particle expected = make_particle(i);
+	return p.x == expected.x && p.mass == expected.mass && p.flags == expected.flags && p.group == expected.group;
+}
+
+static particle gather(registry& reg, entity_id e)
+{
+	soa<particle> p = reg.get<particle>(e);
+	return particle{ p.x, p.mass, p.flags, p.group };
+}
+
+// every skip-th entity (none for 0) is expected to have lost its particle
+static bool matches(registry& reg, const dyn_array<entity_id>& ids, usize skip)
+{
+	bool out = true;
+
+	for (usize i = 0; i < ids.size(); i++)
+	{
+		bool expected = !skip || i % skip != 0;
+
+		out &= reg.has<particle>(ids[i]) == expected;
+		out &= !expected || same(gather(reg, ids[i]), i);
+	}
+
+	return out;
+}
+
+int main()
+{
+	string path = (std::filesystem::temp_directory_path() / "kawa_soa_test.bin").string();
+
+	kw_tests_start_group(soa)
+	{
+		kw_test(scatter_gather)
+		{
+			registry reg({ .max_entity_count = 512 });
+			dyn_array<entity_id> ids;
+			dyn_array<particle> constructed;
+
+			reg.on_construct([&](entity_id, particle& p) { constructed.push_back(p); });
+
+			for (usize i = 0; i < 500; i++)
+			{
+				ids.push_back(reg.entity(make_particle(i), tag{ (int)i }));
+			}
+
+			for (usize i = 0; i < ids.size(); i += 4)
+			{
+				reg.erase<particle>(ids[i]);
+			}
+
+			bool listened = constructed.size() == 500;
+
+			for (usize i = 0; i < constructed.size() && listened; i++)
+			{
+				listened &= same(constructed[i], i);
+			}
+
+			kw_test_require(listened);
+			kw_test_require(matches(reg, ids, 4));
+
+			reg.get<particle>(ids[1]).mass = 100.0;
+
+			kw_test_require(gather(reg, ids[1]).mass == 100.0);
+			kw_test_require(gather(reg, ids[1]).x == 1.0f);
+		};
+
+		kw_test(queries_and_field_span)
+		{
+			registry reg({ .max_entity_count = 512 });
+			task_manager tm(3);
+			dyn_array<entity_id> ids;
+
+			for (usize i = 0; i < 400; i++)
+			{
+				ids.push_back(reg.entity(make_particle(i)));
+
+				if (i % 2) reg.emplace<tag>(ids.back(), (int)i);
+			}
+
+			reg.query([](soa<particle> p, const tag& t) { p.mass += t.value; });
+
+			dyn_array<task_handle> handles;
+			reg.query_par(tm, task_schedule_policy::wait_if_neccesary, 5, handles, [](soa<particle> p) { p.group += 1; });
+			tm.wait(handles);
+
+			bool queried = true;
+
+			reg.query(
+				[&](entity_id e, soa<particle> p)
+				{
+					usize i = (usize)(u64)e;
+					queried &= p.x == (float)i && p.group == (u16)(i * 3 + 1);
+					queried &= p.mass == i * 0.5 + (i % 2 ? (double)i : 0.0);
+				}
+			);
+
+			span<double> masses = reg.field_span<&particle::mass>();
+			span<u8> flags = reg.field_span<&particle::flags>();
+
+			bool spans = masses.size() >= ids.size();
+
+			for (usize i = 0; i < ids.size(); i++)
+			{
+				spans &= masses[ids[i]] == gather(reg, ids[i]).mass;
+				spans &= flags[ids[i]] == (u8)(i % 7);
+			}
+
+			kw_test_require(queried);
+			kw_test_require(spans);
+		};
+
+		kw_test(copy)
+		{
+			registry reg({ .max_entity_count = 256 });
+			dyn_array<entity_id> ids;
+
+			for (usize i = 0; i < 200; i++)
+			{
+				ids.push_back(reg.entity(make_particle(i)));
+			}
+
+			for (usize i = 0; i < ids.size(); i += 3)
+			{
+				reg.destroy(ids[i]);
+			}
+
+			registry copy = reg;
+			reg.query([](soa<particle> p) { p.x = -1.0f; });
+
+			kw_test_require(matches(copy, ids, 3));
+		};
+
+		kw_test(diff_round_trip)
+		{
+			registry source({ .max_entity_count = 256 });
+			registry replica({ .max_entity_count = 256 });
+			dyn_array<entity_id> ids;
+
+			for (usize i = 0; i < 200; i++)
+			{
+				ids.push_back(source.entity(make_particle(i)));
+			}
+
+			dyn_array<u8> data;
+			source.diff(replica, data);
+			replica.apply_diff<particle>(data);
+
+			bool first = matches(replica, ids, 0);
+
+			for (usize i = 0; i < ids.size(); i += 5)
+			{
+				source.erase<particle>(ids[i]);
+			}
+
+			source.get<particle>(ids[1]).flags = 42;
+
+			data.clear();
+			source.diff(replica, data);
+			replica.apply_diff<particle>(data);
+
+			kw_test_require(first);
+			kw_test_require(replica.get<particle>(ids[1]).flags == 42);
+
+			source.get<particle>(ids[1]).flags = make_particle(1).flags;
+			replica.get<particle>(ids[1]).flags = make_particle(1).flags;
+
+			kw_test_require(matches(replica, ids, 5));
+		};
+
+		kw_test(snapshot_round_trip)
+		{
+			dyn_array<entity_id> ids;
+
+			{
+				registry reg({ .max_entity_count = 512 });
+
+				for (usize i = 0; i < 300; i++)
+				{
+					ids.push_back(reg.entity(make_particle(i), tag{ (int)i }));
+				}
+
+				for (usize i = 0; i < ids.size(); i += 6)
+				{
+					reg.erase<particle>(ids[i]);
+				}
+
+				reg.save_snapshot(path);
+			}
+
+			registry loaded({ .max_entity_count = 512 });
+			loaded.load_snapshot<particle, tag>(path);
+
+			bool intact = matches(loaded, ids, 6);
+
+			// mapped field arrays stay writable
+			loaded.query([](soa<particle> p) { p.group = 7; });
+
+			usize sevens = 0;
+			span<u16> groups = loaded.field_span<&particle::group>();
+
+			for (usize i = 0; i < ids.size(); i++)
+			{
+				sevens += i % 6 != 0 && groups[ids[i]] == 7;
+			}
+
+			kw_test_require(intact);
+			kw_test_require(sevens == 250);
+		};
+	};
+
+	kw_tests_print_summary();
+	std::filesystem::remove(path);
+	return kw_tests_exit_code();
+}
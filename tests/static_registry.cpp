@@ -0,0 +1,97 @@
+#include "../kawa/core/static_registry.h"
+#include "../kawa/core/testing.h"
+
+using namespace kawa;
+
+struct position { float x, y; };
+struct velocity { float v; };
+struct name { string value; };
+
+int main()
+{
+	kw_tests_start_group(static_registry)
+	{
+		kw_test(queries)
+		{
+			static_registry<position, velocity, name> reg({ .max_entity_count = 10000 });
+
+			for (int i = 0; i < 10000; i++)
+			{
+				entity_id e = reg.entity(position{ (float)i, 0.0f });
+
+				if (i % 2) reg.emplace<velocity>(e, 1.0f);
+				if (i % 10 == 0) reg.add(e, name{ "named entity with a heap allocated string" });
+			}
+
+			usize required = 0;
+			reg.query([&](position& p, velocity& v) { p.y += v.v; required++; });
+
+			usize named = 0;
+			reg.query([&](entity_id, name* n) { named += n != nullptr; });
+
+			const auto& read_only = reg;
+			double moved = 0.0;
+			read_only.query([&](const position& p, const velocity*) { moved += p.y; });
+
+			dyn_array<entity_id> ids = { 1, 2, 3 };
+			usize with = 0;
+			reg.query_with(span<const entity_id>(ids), [&](velocity&) { with++; });
+
+			kw_test_require(required == 5000);
+			kw_test_require(named == 1000);
+			kw_test_require(moved == 5000.0);
+			kw_test_require(with == 2);
+		};
+
+		kw_test(query_par)
+		{
+			static_registry<position, velocity> reg({ .max_entity_count = 10000 });
+			task_manager tm(4);
+
+			for (int i = 0; i < 10000; i++)
+			{
+				entity_id e = reg.entity(position{ (float)i, 0.0f });
+
+				if (i % 4 == 0) reg.emplace<velocity>(e, 2.0f);
+			}
+
+			dyn_array<task_handle> handles;
+			reg.query_par(tm, task_schedule_policy::wait_if_neccesary, 7, handles, [](position& p, const velocity& v) { p.y = v.v; });
+			tm.wait(handles);
+
+			atomic<usize> all{ 0 };
+			handles.clear();
+			reg.query_par(tm, task_schedule_policy::wait_if_neccesary, 3, handles, [&](entity_id, position&) { all++; });
+			tm.wait(handles);
+
+			usize moved = 0;
+			reg.query([&](const position& p) { moved += p.y == 2.0f; });
+
+			kw_test_require(moved == 2500);
+			kw_test_require(all.load() == 10000);
+		};
+
+		kw_test(lifetime)
+		{
+			static_registry<position, name> reg({ .max_entity_count = 16 });
+
+			entity_id a = reg.entity(position{ 1.0f, 2.0f }, name{ "a" });
+			entity_id b = reg.entity(position{ 3.0f, 4.0f });
+
+			reg.destroy(a);
+			entity_id reused = reg.entity();
+			reg.clone(b, reused);
+
+			auto copy = reg;
+
+			kw_test_require(reused == a);
+			kw_test_require(!reg.has<name>(reused));
+			kw_test_require(reg.get<position>(reused).x == 3.0f);
+			kw_test_require(copy.entity_count() == 2);
+			kw_test_require(copy.get<position>(b).y == 4.0f);
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
@@ -0,0 +1,117 @@
+#include "../kawa/core/task_manager.h"
+#include "../kawa/core/testing.h"
+
+#include <cstdlib>
+
+using namespace kawa;
+
+// big captures go through the aligned overloads, counting them shows whether freed blocks come back
+static atomic<usize> aligned_allocations{ 0 };
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	aligned_allocations.fetch_add(1, std::memory_order_relaxed);
+
+	usize a = (usize)alignment;
+
+#ifdef _MSC_VER
+	void* ptr = _aligned_malloc(size, a);
+#else
+	void* ptr = std::aligned_alloc(a, (size + a - 1) / a * a);
+#endif
+
+	if (!ptr) throw std::bad_alloc();
+
+	return ptr;
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+#ifdef _MSC_VER
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(ptr, alignment);
+}
+
+struct big_capture
+{
+	array<u64, 30> payload;
+};
+
+struct alignas(128) overaligned_capture
+{
+	u64 value;
+};
+
+int main()
+{
+	kw_tests_start_group(task_fn)
+	{
+		kw_test(blocks_freed_on_workers_are_reused)
+		{
+			task_manager tm(2);
+			atomic<u64> sum{ 0 };
+
+			constexpr usize batches = 100;
+			constexpr usize per_batch = 100;
+
+			usize before = aligned_allocations.load();
+
+			for (usize b = 0; b < batches; b++)
+			{
+				dyn_array<task_handle> handles;
+
+				for (usize i = 0; i < per_batch; i++)
+				{
+					big_capture capture{};
+					capture.payload[0] = i;
+
+					handles.push_back(tm.schedule([capture, &sum]() { sum += capture.payload[0]; }));
+				}
+
+				tm.wait(handles);
+			}
+
+			usize allocated = aligned_allocations.load() - before;
+
+			kw_test_require(sum.load() == batches * per_batch * (per_batch - 1) / 2);
+			// without blocks flowing back every capture scheduled from this thread would allocate
+			kw_test_require(allocated < batches * per_batch / 4);
+		};
+
+		kw_test(overaligned_captures)
+		{
+			task_manager tm(2);
+			atomic<bool> aligned{ true };
+			atomic<u64> sum{ 0 };
+			dyn_array<task_handle> handles;
+
+			for (u64 i = 0; i < 1000; i++)
+			{
+				overaligned_capture capture{ i };
+
+				handles.push_back(tm.schedule(
+					[capture, &aligned, &sum]()
+					{
+						aligned = aligned && (usize)&capture % alignof(overaligned_capture) == 0;
+						sum += capture.value;
+					}
+				));
+			}
+
+			tm.wait(handles);
+
+			kw_test_require(aligned.load());
+			kw_test_require(sum.load() == 999 * 1000 / 2);
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}
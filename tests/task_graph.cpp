@@ -0,0 +1,101 @@
+#include "../kawa/core/task_graph.h"
+#include "../kawa/core/coroutine.h"
+#include "../kawa/core/testing.h"
+
+using namespace kawa;
+
+int main()
+{
+	kw_tests_start_group(task_graph)
+	{
+		kw_test(diamond_and_fan_out)
+		{
+			task_manager tm(4);
+			task_graph g;
+
+			atomic<int> a{ 0 }, b{ 0 }, c{ 0 }, d{ 0 }, fanned{ 0 };
+			atomic<bool> out_of_order{ false };
+
+			auto A = g.add([&]() { a++; });
+			auto B = g.add([&]() { out_of_order = out_of_order || a.load() != b.load() + 1; b++; }, { A });
+			auto C = g.add([&]() { out_of_order = out_of_order || a.load() != c.load() + 1; c++; }, { A });
+			auto D = g.add([&]() { out_of_order = out_of_order || b.load() != d.load() + 1 || c.load() != d.load() + 1; d++; }, { B, C });
+
+			for (int i = 0; i < 50; i++)
+			{
+				auto f = g.add([&]() { out_of_order = out_of_order || d.load() * 50 <= fanned.load(); fanned++; });
+				g.precede(D, f);
+			}
+
+			constexpr int frames = 2000;
+
+			for (int frame = 0; frame < frames; frame++)
+			{
+				g.run(tm);
+			}
+
+			kw_test_require(!out_of_order.load());
+			kw_test_require(a.load() == frames && d.load() == frames);
+			kw_test_require(fanned.load() == frames * 50);
+		};
+
+		kw_test(long_chain)
+		{
+			task_manager tm(4);
+			task_graph g;
+
+			dyn_array<int> order;
+			task_graph::node_id last = g.add([&]() { order.push_back(0); });
+
+			for (int i = 1; i < 200; i++)
+			{
+				last = g.add([&order, i]() { order.push_back(i); }, { last });
+			}
+
+			g.run(tm);
+
+			bool sequential = order.size() == 200;
+
+			for (int i = 0; i < (int)order.size(); i++)
+			{
+				sequential &= order[i] == i;
+			}
+
+			kw_test_require(sequential);
+		};
+
+		kw_test(empty_graph)
+		{
+			task_manager tm(2);
+			task_graph g;
+
+			task_handle th = g.submit(tm);
+			tm.wait(th);
+
+			kw_test_require(th.done());
+		};
+
+		kw_test(awaited_from_a_coroutine)
+		{
+			task_manager tm(2);
+			task_graph g;
+			atomic<int> ran{ 0 };
+
+			auto first = g.add([&]() { ran++; });
+			g.add([&]() { ran++; }, { first });
+
+			int seen = sync_wait(
+				[](task_manager& tm, task_graph& g, atomic<int>& ran) -> task<int>
+				{
+					co_await when_done(g.submit(tm));
+					co_return ran.load();
+				}(tm, g, ran)
+			);
+
+			kw_test_require(seen == 2);
+		};
+	};
+
+	kw_tests_print_summary();
+	return kw_tests_exit_code();
+}